@@ -0,0 +1,351 @@
+// bench/wordcount_bench.cpp
+//
+// Benchmark harness: generates a deterministic Zipf corpus (or uses a given
+// one), then runs the wordcount binary over every combination of variant,
+// tokenizer kernel, batch size and thread count, several times each, and
+// prints one CSV row per combination with the median and p95 run times,
+// the throughput they give and the scaling over the smallest thread count.
+//
+// Times are the run's own `total` from --metrics=json, which leaves out
+// process start-up. p95_s is the nearest-rank 95th percentile of the run
+// times, so p95_mb_s is the throughput 95% of the runs reached.
+//
+// A variant is a named set of extra wordcount arguments, which is how
+// table and tokenizer settings are swept: --variant fold=--fold-case.
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "tokenizer.hpp"
+#include "zipf_corpus.hpp"
+
+namespace {
+
+struct Variant {
+    std::string name;
+    std::vector<std::string> args;
+};
+
+struct BenchOptions {
+    std::string wordcount = WORDCOUNT_BENCH_BINARY;
+    std::string corpus;  // existing or to be generated; "" = temporary
+    CorpusSpec spec;
+    std::vector<unsigned int> threads;
+    std::vector<std::size_t> batches;
+    std::vector<std::string> kernels;
+    std::vector<Variant> variants;
+    unsigned int repeat = 5;
+};
+
+struct Sample {
+    double seconds;
+    std::uint64_t bytes, words;
+};
+
+void printUsage(std::ostream& out) {
+    out << "Usage: wordcount_bench [options]\n"
+        << "Options (LIST is comma-separated):\n"
+        << "  --wordcount PATH  binary to measure (default: the one built alongside)\n"
+        << "  --corpus FILE     count FILE; it is generated first if it doesn't exist\n"
+        << "                    (default: a temporary corpus, removed afterwards)\n"
+        << "  --size SIZE       generated corpus size, K/M/G allowed (default 256M)\n"
+        << "  --vocab N         distinct words in the generated corpus (default 1000000)\n"
+        << "  --zipf S          Zipf exponent of the generated corpus (default 1.0)\n"
+        << "  --seed N          generator seed (default 1)\n"
+        << "  --threads LIST    thread counts (default: 1, 2, 4, ... up to the CPU's)\n"
+        << "  --batch LIST      batch sizes (default 256M)\n"
+        << "  --kernels LIST    tokenizer kernels (default: every one this CPU runs)\n"
+        << "  --variant NAME=ARGS\n"
+        << "                    also sweep wordcount with the space-separated ARGS;\n"
+        << "                    may be repeated (default: one variant, no extra args)\n"
+        << "  --repeat N        runs per combination (default 5)\n"
+        << "  -h, --help        show this help\n";
+}
+
+bool parseCount(std::string_view text, std::uint64_t& n) {
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), n);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+// "64M", "1G", "4096"
+bool parseSize(std::string_view text, std::uint64_t& bytes) {
+    unsigned int shift = 0;
+    if (!text.empty()) {
+        switch (text.back() | 0x20) {
+        case 'k': shift = 10; break;
+        case 'm': shift = 20; break;
+        case 'g': shift = 30; break;
+        }
+        if (shift != 0) text.remove_suffix(1);
+    }
+    std::uint64_t n = 0;
+    if (!parseCount(text, n) || n == 0 || n > (UINT64_MAX >> shift)) return false;
+    bytes = n << shift;
+    return true;
+}
+
+std::vector<std::string_view> splitList(std::string_view text, char separator) {
+    std::vector<std::string_view> items;
+    while (!text.empty()) {
+        std::size_t cut = std::min(text.find(separator), text.size());
+        if (cut != 0) items.push_back(text.substr(0, cut));
+        text.remove_prefix(std::min(cut + 1, text.size()));
+    }
+    return items;
+}
+
+bool parseOptions(int argc, char* argv[], BenchOptions& options, std::string& error) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            error.clear();
+            return false;
+        }
+        if (i + 1 >= argc) {
+            error = "unknown option or missing value: " + std::string(arg);
+            return false;
+        }
+        std::string_view value = argv[++i];
+        std::uint64_t n = 0;
+        bool valid = true;
+        if (arg == "--wordcount") {
+            options.wordcount = std::string(value);
+        } else if (arg == "--corpus") {
+            options.corpus = std::string(value);
+        } else if (arg == "--size") {
+            valid = parseSize(value, options.spec.bytes);
+        } else if (arg == "--vocab") {
+            valid = parseCount(value, n) && n != 0;
+            options.spec.vocabulary = n;
+        } else if (arg == "--zipf") {
+            char* end = nullptr;
+            std::string text(value);
+            options.spec.exponent = std::strtod(text.c_str(), &end);
+            valid = end == text.c_str() + text.size() && options.spec.exponent > 0;
+        } else if (arg == "--seed") {
+            valid = parseCount(value, options.spec.seed);
+        } else if (arg == "--threads") {
+            for (auto item : splitList(value, ','))
+                if ((valid = valid && parseCount(item, n) && n != 0))
+                    options.threads.push_back(static_cast<unsigned int>(n));
+        } else if (arg == "--batch") {
+            for (auto item : splitList(value, ','))
+                if ((valid = valid && parseSize(item, n))) options.batches.push_back(n);
+        } else if (arg == "--kernels") {
+            for (auto item : splitList(value, ',')) options.kernels.emplace_back(item);
+        } else if (arg == "--variant") {
+            std::size_t eq = value.find('=');
+            valid = eq != 0 && eq != std::string_view::npos;
+            if (valid) {
+                Variant variant{std::string(value.substr(0, eq)), {}};
+                for (auto item : splitList(value.substr(eq + 1), ' '))
+                    variant.args.emplace_back(item);
+                options.variants.push_back(std::move(variant));
+            }
+        } else if (arg == "--repeat") {
+            valid = parseCount(value, n) && n != 0;
+            options.repeat = static_cast<unsigned int>(n);
+        } else {
+            error = "unknown option " + std::string(arg);
+            return false;
+        }
+        if (!valid) {
+            error = "invalid " + std::string(arg) + " " + std::string(value);
+            return false;
+        }
+    }
+
+    if (options.threads.empty()) {
+        unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int t = 1; t < cores; t *= 2) options.threads.push_back(t);
+        options.threads.push_back(cores);
+    }
+    std::sort(options.threads.begin(), options.threads.end());
+    options.threads.erase(std::unique(options.threads.begin(), options.threads.end()),
+                          options.threads.end());
+    if (options.batches.empty()) options.batches.push_back(std::size_t(256) << 20);
+    if (options.kernels.empty())
+        for (auto const& kernel : availableTokenizerKernels())
+            options.kernels.emplace_back(kernel.name);
+    if (options.variants.empty()) options.variants.push_back({"default", {}});
+    return true;
+}
+
+// the number after "key": in a one-line JSON object
+bool jsonNumber(std::string_view json, std::string_view key, std::uint64_t& value) {
+    std::string pattern = "\"" + std::string(key) + "\":";
+    std::size_t at = json.find(pattern);
+    if (at == std::string_view::npos) return false;
+    json.remove_prefix(at + pattern.size());
+    return std::from_chars(json.data(), json.data() + json.size(), value).ec == std::errc();
+}
+
+// Runs wordcount once in `workDir` and reads its metrics.
+bool runOnce(const std::string& binary, const std::vector<std::string>& args,
+             const std::string& workDir, Sample& sample, std::string& error) {
+    int out[2];
+    if (::pipe(out) != 0) {
+        error = std::string("pipe: ") + std::strerror(errno);
+        return false;
+    }
+    pid_t child = ::fork();
+    if (child < 0) {
+        error = std::string("fork: ") + std::strerror(errno);
+        return false;
+    }
+    if (child == 0) {
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>(binary.c_str()));
+        for (auto const& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        ::dup2(out[1], STDOUT_FILENO);
+        ::close(out[0]);
+        ::close(out[1]);
+        if (::chdir(workDir.c_str()) == 0) ::execv(binary.c_str(), argv.data());
+        std::perror(binary.c_str());
+        ::_exit(127);
+    }
+    ::close(out[1]);
+    std::string output;
+    char buffer[4096];
+    for (ssize_t n; (n = ::read(out[0], buffer, sizeof buffer)) != 0;) {
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) break;
+        output.append(buffer, static_cast<std::size_t>(n));
+    }
+    ::close(out[0]);
+    int status = 0;
+    ::waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        error = binary + " failed";
+        return false;
+    }
+
+    // the metrics are the last line
+    std::string_view json = output;
+    while (!json.empty() && json.back() == '\n') json.remove_suffix(1);
+    json.remove_prefix(json.rfind('\n') + 1);  // npos + 1 == 0
+    std::uint64_t totalUs = 0;
+    if (!jsonNumber(json, "total", totalUs) || !jsonNumber(json, "input_bytes", sample.bytes)
+        || !jsonNumber(json, "words", sample.words)) {
+        error = binary + " printed no metrics";
+        return false;
+    }
+    sample.seconds = std::max<std::uint64_t>(totalUs, 1) / 1e6;
+    return true;
+}
+
+// nearest rank; `sorted` is ascending and not empty
+double percentile(const std::vector<double>& sorted, double p) {
+    std::size_t rank = static_cast<std::size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<std::size_t>(rank, 1)) - 1];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    std::string error;
+    if (!parseOptions(argc, argv, options, error)) {
+        if (!error.empty()) std::cerr << "Error: " << error << "\n";
+        printUsage(error.empty() ? std::cout : std::cerr);
+        return error.empty() ? 0 : 1;
+    }
+
+    const char* tmp = std::getenv("TMPDIR");
+    std::string tmpDir = tmp && *tmp ? tmp : "/tmp";
+    std::string workDir = tmpDir + "/wordcount-bench-XXXXXX";
+    if (!::mkdtemp(workDir.data())) {
+        std::cerr << "Error: could not create a directory in " << tmpDir << ": "
+                  << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    bool temporaryCorpus = options.corpus.empty();
+    if (temporaryCorpus) options.corpus = workDir + "/corpus.txt";
+    if (temporaryCorpus || ::access(options.corpus.c_str(), F_OK) != 0) {
+        std::cerr << "[bench] generating " << options.spec.bytes << " bytes, "
+                  << options.spec.vocabulary << " words, zipf " << options.spec.exponent
+                  << ", seed " << options.spec.seed << " -> " << options.corpus << "\n";
+        if (!writeZipfCorpus(options.corpus, options.spec, error)) {
+            std::cerr << "Error: " << error << "\n";
+            ::rmdir(workDir.c_str());
+            return 1;
+        }
+    }
+    auto cleanUp = [&] {
+        for (const char* name : {"/output.txt", "/output2.txt"})
+            ::unlink((workDir + name).c_str());
+        if (temporaryCorpus) ::unlink(options.corpus.c_str());
+        ::rmdir(workDir.c_str());
+    };
+
+    std::cout << "variant,kernel,batch_bytes,threads,runs,input_bytes,median_s,p95_s,"
+                 "median_mb_s,p95_mb_s,median_mwords_s,speedup,efficiency\n";
+    for (auto const& variant : options.variants) {
+        for (auto const& kernel : options.kernels) {
+            for (std::size_t batch : options.batches) {
+                double baseSeconds = 0;
+                unsigned int baseThreads = 0;
+                for (unsigned int threads : options.threads) {
+                    std::vector<std::string> args = {
+                        "-q", "--metrics=json", "--threads", std::to_string(threads),
+                        "--batch-size", std::to_string(batch), "--kernel", kernel};
+                    args.insert(args.end(), variant.args.begin(), variant.args.end());
+                    args.push_back(options.corpus);
+
+                    // one untimed run warms the page cache and the allocator
+                    std::vector<double> seconds;
+                    Sample sample{};
+                    for (unsigned int run = 0; run <= options.repeat; ++run) {
+                        std::cerr << "[bench] " << variant.name << " " << kernel << " batch "
+                                  << batch << " threads " << threads << " run " << run << "/"
+                                  << options.repeat << "\r" << std::flush;
+                        if (!runOnce(options.wordcount, args, workDir, sample, error)) {
+                            std::cerr << "\nError: " << error << "\n";
+                            cleanUp();
+                            return 1;
+                        }
+                        if (run != 0) seconds.push_back(sample.seconds);
+                    }
+                    std::sort(seconds.begin(), seconds.end());
+                    double median = percentile(seconds, 0.5);
+                    double p95 = percentile(seconds, 0.95);
+                    if (baseThreads == 0) {
+                        baseSeconds = median;
+                        baseThreads = threads;
+                    }
+                    double speedup = baseSeconds / median;
+                    double efficiency = speedup * baseThreads / threads;
+
+                    char row[512];
+                    std::snprintf(row, sizeof row,
+                                  "%s,%s,%zu,%u,%u,%llu,%.6f,%.6f,%.2f,%.2f,%.3f,%.3f,%.3f\n",
+                                  variant.name.c_str(), kernel.c_str(), batch, threads,
+                                  options.repeat, static_cast<unsigned long long>(sample.bytes),
+                                  median, p95, sample.bytes / median / 1e6,
+                                  sample.bytes / p95 / 1e6, sample.words / median / 1e6,
+                                  speedup, efficiency);
+                    std::cout << row << std::flush;
+                }
+            }
+        }
+    }
+    std::cerr << "\n";
+    cleanUp();
+    return 0;
+}
@@ -0,0 +1,119 @@
+// bench/zipf_corpus.cpp
+
+#include "zipf_corpus.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// a-z, then ä, ö and å as UTF-8
+const char* const kLetters[] = {
+    "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m", "n", "o",
+    "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z", "\xc3\xa4", "\xc3\xb6", "\xc3\xa5",
+};
+constexpr std::uint64_t kLetterCount = sizeof(kLetters) / sizeof(kLetters[0]);
+// positions with their own letter order; word i uses i's digits through them
+constexpr std::size_t kShuffledPositions = 8;
+constexpr std::size_t kWriteBuffer = std::size_t(1) << 20;
+
+// splitmix64: tiny, fast and the same everywhere
+class Random {
+public:
+    explicit Random(std::uint64_t seed) : state_(seed) {}
+    std::uint64_t next() {
+        std::uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    // uniform in [0, 1)
+    double unit() { return (next() >> 11) * 0x1.0p-53; }
+    std::uint64_t below(std::uint64_t n) { return next() % n; }
+
+private:
+    std::uint64_t state_;
+};
+
+// The words of every rank, back to back. Rank r is r + kLetterCount + 1
+// written in bijective base kLetterCount, so every word is distinct and at
+// least two letters long, and low ranks get the short words.
+void buildVocabulary(std::size_t words, Random& random, std::string& blob,
+                     std::vector<std::size_t>& offsets) {
+    std::uint64_t order[kShuffledPositions][kLetterCount];
+    for (auto& position : order) {
+        for (std::uint64_t i = 0; i < kLetterCount; ++i) position[i] = i;
+        for (std::uint64_t i = kLetterCount - 1; i > 0; --i)
+            std::swap(position[i], position[random.below(i + 1)]);
+    }
+    offsets.assign(1, 0);
+    offsets.reserve(words + 1);
+    for (std::size_t r = 0; r < words; ++r) {
+        std::uint64_t n = r + kLetterCount + 1;
+        for (std::size_t position = 0; n != 0; ++position) {
+            --n;
+            blob += kLetters[order[position % kShuffledPositions][n % kLetterCount]];
+            n /= kLetterCount;
+        }
+        offsets.push_back(blob.size());
+    }
+}
+
+}  // namespace
+
+bool writeZipfCorpus(const std::string& path, const CorpusSpec& spec, std::string& error) {
+    if (spec.vocabulary == 0) {
+        error = "the vocabulary must not be empty";
+        return false;
+    }
+    Random random(spec.seed);
+    std::string blob;
+    std::vector<std::size_t> offsets;
+    buildVocabulary(spec.vocabulary, random, blob, offsets);
+
+    // cumulative weights; a rank is drawn by binary search on a uniform value
+    std::vector<double> cdf(spec.vocabulary);
+    double sum = 0;
+    for (std::size_t r = 0; r < spec.vocabulary; ++r) {
+        sum += 1.0 / std::pow(static_cast<double>(r + 1), spec.exponent);
+        cdf[r] = sum;
+    }
+
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) {
+        error = "could not create " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    std::string buffer;
+    buffer.reserve(kWriteBuffer + 256);
+    std::uint64_t written = 0;
+    bool ok = true;
+    while (ok && written + buffer.size() < spec.bytes) {
+        double u = random.unit() * sum;
+        std::size_t r = std::min<std::size_t>(
+            std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin(), spec.vocabulary - 1);
+        buffer.append(blob, offsets[r], offsets[r + 1] - offsets[r]);
+        // about twelve words to a line, with some punctuation
+        std::uint64_t gap = random.below(60);
+        buffer += gap < 5 ? "\n" : gap < 8 ? ", " : gap < 10 ? ". " : " ";
+        if (buffer.size() >= kWriteBuffer) {
+            ok = std::fwrite(buffer.data(), 1, buffer.size(), out) == buffer.size();
+            written += buffer.size();
+            buffer.clear();
+        }
+    }
+    if (ok && !buffer.empty())
+        ok = std::fwrite(buffer.data(), 1, buffer.size(), out) == buffer.size();
+    if (std::fclose(out) != 0) ok = false;
+    if (!ok) {
+        error = "could not write " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
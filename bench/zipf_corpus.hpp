@@ -0,0 +1,27 @@
+// bench/zipf_corpus.hpp
+//
+// Deterministic synthetic corpora for benchmarking. Word ranks are drawn
+// from a Zipf distribution (the frequency of rank r is proportional to
+// 1 / (r + 1)^exponent), the shape of real text, so the hot words, the
+// long tail and the table sizes behave as they do on a real dump. Words
+// are lowercase UTF-8 over a-z plus ä, ö and å; frequent words are short,
+// rare ones long. The same spec always produces the same bytes: the
+// generator uses its own PRNG and sampling instead of <random>'s
+// distributions, whose output differs between standard libraries.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct CorpusSpec {
+    std::uint64_t bytes = std::uint64_t(256) << 20;  // corpus size, rounded up to a word
+    std::size_t vocabulary = 1'000'000;              // distinct words to draw from
+    double exponent = 1.0;                           // Zipf s
+    std::uint64_t seed = 1;
+};
+
+// Writes the corpus described by `spec` to `path`. On failure returns
+// false with a message in `error`.
+bool writeZipfCorpus(const std::string& path, const CorpusSpec& spec, std::string& error);
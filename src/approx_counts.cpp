@@ -0,0 +1,191 @@
+// src/approx_counts.cpp
+
+#include "approx_counts.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+CountMinSketch::CountMinSketch(double epsilon, double delta) {
+    // width >= e / epsilon, rounded up to a power of two so a counter is
+    // picked with a mask
+    double want = std::ceil(std::exp(1.0) / epsilon);
+    width_ = 1;
+    while (static_cast<double>(width_) < want) width_ <<= 1;
+    depth_ = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(std::log(1.0 / delta))));
+    counters_.assign(width_ * depth_, 0);
+}
+
+std::uint64_t CountMinSketch::estimate(std::uint64_t hash) const {
+    if (counters_.empty()) return 0;
+    std::uint64_t h1 = static_cast<std::uint32_t>(hash), h2 = (hash >> 32) | 1;
+    std::size_t mask = width_ - 1;
+    std::uint64_t least = UINT64_MAX;
+    const std::uint64_t* row = counters_.data();
+    for (std::size_t r = 0; r < depth_; ++r, row += width_)
+        least = std::min(least, row[(h1 + r * h2) & mask]);
+    return least;
+}
+
+std::uint64_t CountMinSketch::errorBound() const {
+    if (width_ == 0) return 0;
+    return static_cast<std::uint64_t>(
+        std::ceil(static_cast<long double>(total_) * std::exp(1.0L) / width_));
+}
+
+void CountMinSketch::mergeCounters(const CountMinSketch& other, std::size_t first,
+                                   std::size_t last) {
+    std::uint64_t* to = counters_.data();
+    const std::uint64_t* from = other.counters_.data();
+    for (std::size_t i = first; i < last; ++i) to[i] += from[i];
+}
+
+SpaceSaving::SpaceSaving(std::size_t capacity) : capacity_(capacity) {
+    entries_.reserve(capacity);
+    std::size_t slots = 16;
+    while (slots < capacity * 2) slots <<= 1;
+    slots_.assign(slots, 0);
+}
+
+namespace {
+
+std::size_t slotFor(std::uint64_t hash, std::size_t slots) {
+    return static_cast<std::size_t>((hash * 0x9E3779B97F4A7C15ull) >> 32) & (slots - 1);
+}
+
+}  // namespace
+
+std::uint32_t SpaceSaving::find(std::string_view key, std::uint64_t hash) const {
+    std::size_t mask = slots_.size() - 1;
+    for (std::size_t i = slotFor(hash, slots_.size()); slots_[i] != 0; i = (i + 1) & mask) {
+        const Entry& e = entries_[slots_[i] - 1];
+        if (e.hash == hash && e.key == key) return slots_[i] - 1;
+    }
+    return kMissing;
+}
+
+void SpaceSaving::index(std::uint32_t entry) {
+    std::size_t mask = slots_.size() - 1;
+    std::size_t i = slotFor(entries_[entry].hash, slots_.size());
+    while (slots_[i] != 0) i = (i + 1) & mask;
+    slots_[i] = entry + 1;
+}
+
+void SpaceSaving::unindex(std::uint32_t entry) {
+    std::size_t mask = slots_.size() - 1;
+    std::size_t hole = slotFor(entries_[entry].hash, slots_.size());
+    while (slots_[hole] != entry + 1) hole = (hole + 1) & mask;
+    // shift back every later entry of the run that may move into the hole,
+    // i.e. whose home slot isn't cyclically in (hole, i]
+    for (std::size_t i = (hole + 1) & mask; slots_[i] != 0; i = (i + 1) & mask) {
+        std::size_t home = slotFor(entries_[slots_[i] - 1].hash, slots_.size());
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            slots_[hole] = slots_[i];
+            hole = i;
+        }
+    }
+    slots_[hole] = 0;
+}
+
+std::uint64_t SpaceSaving::floor() const {
+    return entries_.size() < capacity_ || heap_.empty() ? 0 : entries_[heap_[0]].count;
+}
+
+void SpaceSaving::siftUp(std::size_t at) {
+    std::uint32_t entry = heap_[at];
+    while (at > 0) {
+        std::size_t parent = (at - 1) / 2;
+        if (entries_[heap_[parent]].count <= entries_[entry].count) break;
+        heap_[at] = heap_[parent];
+        position_[heap_[at]] = static_cast<std::uint32_t>(at);
+        at = parent;
+    }
+    heap_[at] = entry;
+    position_[entry] = static_cast<std::uint32_t>(at);
+}
+
+void SpaceSaving::siftDown(std::size_t at) {
+    std::uint32_t entry = heap_[at];
+    for (;;) {
+        std::size_t child = 2 * at + 1;
+        if (child >= heap_.size()) break;
+        if (child + 1 < heap_.size()
+            && entries_[heap_[child + 1]].count < entries_[heap_[child]].count)
+            ++child;
+        if (entries_[entry].count <= entries_[heap_[child]].count) break;
+        heap_[at] = heap_[child];
+        position_[heap_[at]] = static_cast<std::uint32_t>(at);
+        at = child;
+    }
+    heap_[at] = entry;
+    position_[entry] = static_cast<std::uint32_t>(at);
+}
+
+void SpaceSaving::add(std::string_view key, std::uint64_t hash, std::uint64_t count,
+                      std::uint64_t bound) {
+    if (capacity_ == 0) return;
+    std::uint32_t entry = find(key, hash);
+    if (entry != kMissing) {
+        entries_[entry].count += count;
+        siftDown(position_[entry]);
+        return;
+    }
+    if (entries_.size() < capacity_) {
+        entry = static_cast<std::uint32_t>(entries_.size());
+        entries_.push_back({std::string(key), hash, count, 0});
+        position_.push_back(0);
+        heap_.push_back(entry);
+        index(entry);
+        siftUp(heap_.size() - 1);
+        return;
+    }
+    // the least counted word makes room; the newcomer may have occurred
+    // that often before, unseen, but no more often than `bound`
+    entry = heap_[0];
+    Entry& e = entries_[entry];
+    std::uint64_t start = std::min(e.count + count, bound);
+    if (start <= e.count) return;
+    unindex(entry);
+    e.key.assign(key);
+    e.hash = hash;
+    e.error = start - count;
+    e.count = start;
+    index(entry);
+    siftDown(0);
+}
+
+void SpaceSaving::merge(const SpaceSaving& other) {
+    std::uint64_t ownFloor = floor(), otherFloor = other.floor();
+    std::vector<Entry> merged;
+    merged.reserve(entries_.size() + other.entries_.size());
+    for (auto const& e : entries_) {
+        std::uint32_t o = other.find(e.key, e.hash);
+        if (o != kMissing)
+            merged.push_back({e.key, e.hash, e.count + other.entries_[o].count,
+                              e.error + other.entries_[o].error});
+        else
+            merged.push_back({e.key, e.hash, e.count + otherFloor, e.error + otherFloor});
+    }
+    for (auto const& o : other.entries_)
+        if (find(o.key, o.hash) == kMissing)
+            merged.push_back({o.key, o.hash, o.count + ownFloor, o.error + ownFloor});
+    if (merged.size() > capacity_) {
+        std::nth_element(merged.begin(), merged.begin() + static_cast<std::ptrdiff_t>(capacity_),
+                         merged.end(),
+                         [](Entry const& a, Entry const& b) { return a.count > b.count; });
+        merged.resize(capacity_);
+    }
+    entries_ = std::move(merged);
+    rebuild();
+}
+
+void SpaceSaving::rebuild() {
+    std::fill(slots_.begin(), slots_.end(), 0);
+    heap_.resize(entries_.size());
+    position_.resize(entries_.size());
+    for (std::uint32_t e = 0; e < entries_.size(); ++e) {
+        index(e);
+        heap_[e] = e;
+        position_[e] = e;
+    }
+    for (std::size_t at = heap_.size() / 2; at-- > 0;) siftDown(at);
+}
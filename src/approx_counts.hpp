@@ -0,0 +1,136 @@
+// src/approx_counts.hpp
+//
+// Fixed-memory approximate counting, for corpora whose vocabulary is too
+// large to keep exactly (--approx). Every map thread folds its local counts
+// into two summaries of its own:
+//
+//  - a Count-Min sketch: `depth` rows of `width` counters, a word adding
+//    its count to one counter per row. Any word's count is estimated as the
+//    smallest of its counters, which is never below the true count and, with
+//    probability 1 - delta, at most epsilon * N above it (N = all counted
+//    words), for width >= e / epsilon and depth >= ln(1 / delta).
+//  - a Space-Saving list of the `capacity` most frequent words: a new word
+//    takes the place of the least counted one and inherits its count as
+//    possible overestimate, so every word more frequent than N / capacity is
+//    in the list. The thread's sketch bounds a newcomer's count too: one
+//    whose estimate isn't above the least count stays out, and one that is
+//    starts from the smaller bound. Rare words then no longer churn the
+//    list and push its counts up, which keeps words far below N / capacity
+//    as well.
+//
+// Both merge: sketches by adding their counters element-wise (in slices,
+// so the reduce is a plain array sum over the pool), lists by adding the
+// counts of equal words and keeping the largest. The memory is set by the
+// error bounds, not by the input.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ApproxOptions {
+    bool enabled = false;
+    double epsilon = 0.0001;          // error bound, as a share of all words
+    double delta = 0.01;              // chance a count exceeds that bound
+    std::size_t heavyHitters = 1000;  // words kept in the Space-Saving list
+};
+
+class CountMinSketch {
+public:
+    CountMinSketch() = default;
+    CountMinSketch(double epsilon, double delta);
+
+    bool empty() const { return counters_.empty(); }
+    std::size_t width() const { return width_; }
+    std::size_t depth() const { return depth_; }
+    std::size_t bytes() const { return counters_.size() * sizeof(std::uint64_t); }
+    // the sum of everything added
+    std::uint64_t total() const { return total_; }
+
+    // `hash` is the word hash of word_hash.hpp; the rows' counters are
+    // picked from its two halves (h1 + row * h2)
+    void add(std::uint64_t hash, std::uint64_t count) {
+        std::uint64_t h1 = static_cast<std::uint32_t>(hash), h2 = (hash >> 32) | 1;
+        std::size_t mask = width_ - 1;
+        std::uint64_t* row = counters_.data();
+        for (std::size_t r = 0; r < depth_; ++r, row += width_)
+            row[(h1 + r * h2) & mask] += count;
+        total_ += count;
+    }
+
+    std::uint64_t estimate(std::uint64_t hash) const;
+
+    // The estimates are above the true counts by at most this, with
+    // probability 1 - delta.
+    std::uint64_t errorBound() const;
+
+    // counters [first, last) of `other`, a sketch of the same shape, are
+    // added to this one's; slices can be merged concurrently
+    void mergeCounters(const CountMinSketch& other, std::size_t first, std::size_t last);
+    void mergeTotal(const CountMinSketch& other) { total_ += other.total_; }
+    std::size_t counterCount() const { return counters_.size(); }
+
+private:
+    std::size_t width_ = 0;  // a power of two
+    std::size_t depth_ = 0;
+    std::uint64_t total_ = 0;
+    std::vector<std::uint64_t> counters_;  // row after row
+};
+
+class SpaceSaving {
+public:
+    explicit SpaceSaving(std::size_t capacity = 0);
+
+    std::size_t size() const { return entries_.size(); }
+    std::size_t capacity() const { return capacity_; }
+
+    // Adds `count` to `key`. `bound` is an upper bound of the key's count
+    // so far, this one included (its sketch estimate; UINT64_MAX for none).
+    // A new key on a full list replaces the least counted one unless
+    // `bound` shows it can't have occurred more often. The key is copied.
+    void add(std::string_view key, std::uint64_t hash, std::uint64_t count,
+             std::uint64_t bound = UINT64_MAX);
+
+    // Adds the counts of `other`. A word missing from a full list may have
+    // been counted up to that list's smallest count, so that is added too:
+    // the merged counts stay upper bounds, as in an unmerged list.
+    void merge(const SpaceSaving& other);
+
+    // calls f(key, count, hash, error) for every kept word; the true count
+    // lies in [count - error, count]
+    template<typename F>
+    void forEach(F&& f) const {
+        for (auto const& e : entries_) f(std::string_view(e.key), e.count, e.hash, e.error);
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        std::uint64_t hash;
+        std::uint64_t count;
+        std::uint64_t error;  // count it may have inherited
+    };
+
+    // an entry's position, or kMissing
+    static constexpr std::uint32_t kMissing = UINT32_MAX;
+    std::uint32_t find(std::string_view key, std::uint64_t hash) const;
+    void index(std::uint32_t entry);
+    void unindex(std::uint32_t entry);
+    std::uint64_t floor() const;  // what a missing word may have been counted
+    void siftUp(std::size_t at);
+    void siftDown(std::size_t at);
+    void rebuild();  // the index and heap, after entries_ changed
+
+    std::size_t capacity_;
+    std::vector<Entry> entries_;
+    // entry positions, a min-heap on their counts; position_[e] is e's
+    // place in it
+    std::vector<std::uint32_t> heap_;
+    std::vector<std::uint32_t> position_;
+    // linear probing on the hash, entry + 1 per slot (0 = empty); at most
+    // half full, and deletions shift later entries back, so no tombstones
+    std::vector<std::uint32_t> slots_;
+};
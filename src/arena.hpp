@@ -0,0 +1,94 @@
+// src/arena.hpp
+//
+// Bump-pointer arena for word bytes. Allocation is a pointer increment into
+// the current block; nothing is freed individually. reset() makes the whole
+// arena reusable in one step and keeps its blocks, so a table that is
+// cleared every batch stops allocating once it has warmed up.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+class Arena {
+public:
+    explicit Arena(std::size_t blockSize = std::size_t(1) << 20) : blockSize_(blockSize) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&&) noexcept = default;
+    Arena& operator=(Arena&&) noexcept = default;
+
+    char* allocate(std::size_t n) {
+        if (n > static_cast<std::size_t>(end_ - cursor_))
+            nextBlock(n);
+        char* p = cursor_;
+        cursor_ += n;
+        used_ += n;
+        return p;
+    }
+
+    // copies `s` into the arena and returns a view of the copy
+    std::string_view store(std::string_view s) {
+        if (s.empty()) return {};
+        char* p = allocate(s.size());
+        std::memcpy(p, s.data(), s.size());
+        return {p, s.size()};
+    }
+
+    // forgets every allocation but keeps the blocks for reuse
+    void reset() {
+        current_ = 0;
+        used_ = 0;
+        if (blocks_.empty()) {
+            cursor_ = end_ = nullptr;
+        } else {
+            cursor_ = blocks_[0].data.get();
+            end_ = cursor_ + blocks_[0].size;
+        }
+    }
+
+    // bytes handed out since the last reset
+    std::size_t used() const { return used_; }
+
+    // bytes reserved from the system, used or not
+    std::size_t capacity() const {
+        std::size_t total = 0;
+        for (auto const& b : blocks_) total += b.size;
+        return total;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        std::size_t size;
+    };
+
+    void nextBlock(std::size_t n) {
+        // after a reset, move through the kept blocks before allocating
+        while (!blocks_.empty() && current_ + 1 < blocks_.size()) {
+            ++current_;
+            if (blocks_[current_].size >= n) {
+                cursor_ = blocks_[current_].data.get();
+                end_ = cursor_ + blocks_[current_].size;
+                return;
+            }
+        }
+        std::size_t size = std::max(blockSize_, n);
+        blocks_.push_back({std::unique_ptr<char[]>(new char[size]), size});
+        current_ = blocks_.size() - 1;
+        cursor_ = blocks_.back().data.get();
+        end_ = cursor_ + size;
+    }
+
+    std::size_t blockSize_;
+    std::vector<Block> blocks_;
+    std::size_t current_ = 0;
+    std::size_t used_ = 0;
+    char* cursor_ = nullptr;
+    char* end_ = nullptr;
+};
@@ -0,0 +1,323 @@
+// src/async_reader.cpp
+
+#include "async_reader.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef WORDCOUNT_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace {
+
+// reads in flight, and the bytes of each: large enough for the device to
+// stream, few enough that the ring stays small next to a batch
+constexpr std::size_t kBuffers = 8;
+constexpr std::size_t kBufferBytes = std::size_t(2) << 20;
+// buffers, offsets and lengths of O_DIRECT reads are multiples of this
+constexpr std::size_t kAlignment = 4096;
+
+}  // namespace
+
+#ifdef WORDCOUNT_HAVE_IO_URING
+
+// A minimal io_uring: one submission and one completion queue, set up and
+// entered with the raw system calls (no liburing needed).
+struct AsyncFileReader::Ring {
+    int fd = -1;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    std::size_t sqRingBytes = 0, cqRingBytes = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    std::size_t sqesBytes = 0;
+    unsigned *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+    unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    iovec vectors[kBuffers];  // one per slot, alive while its read is queued
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) ::munmap(sqes, sqesBytes);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) ::munmap(cqRing, cqRingBytes);
+        if (sqRing != MAP_FAILED) ::munmap(sqRing, sqRingBytes);
+        if (fd >= 0) ::close(fd);
+    }
+
+    bool setup(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof params);
+        fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) return false;
+        sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sqRingBytes = cqRingBytes = std::max(sqRingBytes, cqRingBytes);
+        sqRing = ::mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) return false;
+        cqRing = single ? sqRing
+                        : ::mmap(nullptr, cqRingBytes, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) return false;
+        sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) return false;
+
+        char* sq = static_cast<char*>(sqRing);
+        char* cq = static_cast<char*>(cqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    int enter(unsigned submit, unsigned wait, unsigned flags) {
+        for (;;) {
+            long n = ::syscall(__NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0);
+            if (n >= 0 || errno != EINTR) return static_cast<int>(n);
+        }
+    }
+
+    // queues a read of `length` bytes at `offset` of `file` into `data`,
+    // tagged with `slot`
+    bool push(int file, std::size_t slot, char* data, std::size_t length, std::uint64_t offset) {
+        vectors[slot] = {data, length};
+        unsigned tail = *sqTail;  // only this thread writes it
+        unsigned index = tail & *sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof sqe);
+        sqe.opcode = IORING_OP_READV;  // READV, unlike READ, is in every io_uring kernel
+        sqe.fd = file;
+        sqe.addr = reinterpret_cast<std::uint64_t>(&vectors[slot]);
+        sqe.len = 1;
+        sqe.off = offset;
+        sqe.user_data = slot;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        return enter(1, 0, 0) == 1;
+    }
+
+    // the next completion, waiting for one if none is there
+    bool pop(io_uring_cqe& out) {
+        for (;;) {
+            unsigned head = *cqHead;
+            if (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                out = cqes[head & *cqMask];
+                __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+            if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0) return false;
+        }
+    }
+};
+
+#else
+
+struct AsyncFileReader::Ring {};
+
+#endif
+
+bool ioUringAvailable() {
+#ifdef WORDCOUNT_HAVE_IO_URING
+    static const bool available = [] {
+        AsyncFileReader::Ring ring;
+        return ring.setup(1);
+    }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+AsyncFileReader::AsyncFileReader() = default;
+
+AsyncFileReader::~AsyncFileReader() {
+    close();
+}
+
+bool AsyncFileReader::open(const std::string& path, bool direct, std::string& error) {
+    close();
+    int flags = O_RDONLY;
+#ifdef O_DIRECT
+    if (direct) flags |= O_DIRECT;
+#else
+    direct = false;
+#endif
+    fd_ = ::open(path.c_str(), flags);
+    if (fd_ < 0 && direct && errno == EINVAL) {
+        // the filesystem doesn't do O_DIRECT: read through the cache
+        direct = false;
+        fd_ = ::open(path.c_str(), O_RDONLY);
+    }
+    if (fd_ < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode)) {
+        error = "not a regular file";
+        close();
+        return false;
+    }
+    size_ = static_cast<std::uint64_t>(st.st_size);
+    direct_ = direct;
+    if (!direct_) ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    slots_.resize(std::min<std::uint64_t>(kBuffers, (size_ + kBufferBytes - 1) / kBufferBytes));
+    for (auto& slot : slots_) {
+        slot.data = static_cast<char*>(std::aligned_alloc(kAlignment, kBufferBytes));
+        if (!slot.data) {
+            error = "out of memory";
+            close();
+            return false;
+        }
+    }
+#ifdef WORDCOUNT_HAVE_IO_URING
+    ring_ = std::make_unique<Ring>();
+    if (!ring_->setup(static_cast<unsigned>(kBuffers))) ring_.reset();
+#endif
+    for (auto& slot : slots_)
+        if (!submit(slot)) {
+            error = error_;
+            close();
+            return false;
+        }
+    return true;
+}
+
+bool AsyncFileReader::next(std::string_view& chunk) {
+    if (slots_.empty() || !error_.empty()) return false;
+    if (handedOut_) {
+        // the caller is done with the last chunk; its buffer reads on
+        handedOut_ = false;
+        if (!submit(slots_[head_])) return false;
+        head_ = (head_ + 1) % slots_.size();
+    }
+    Slot& slot = slots_[head_];
+    if (!slot.queued || !complete(slot)) return false;
+    std::size_t visible = static_cast<std::size_t>(
+        std::min<std::uint64_t>(slot.filled, size_ - slot.offset));
+    if (visible == 0) return false;  // the file shrank
+    chunk = std::string_view(slot.data, visible);
+    handedOut_ = true;
+    return true;
+}
+
+bool AsyncFileReader::submit(Slot& slot) {
+    slot.queued = slot.done = false;
+    slot.filled = 0;
+    slot.error = 0;
+    if (nextOffset_ >= size_) return true;  // nothing left to read
+    slot.offset = nextOffset_;
+    std::uint64_t left = size_ - nextOffset_;
+    slot.length = static_cast<std::size_t>(std::min<std::uint64_t>(kBufferBytes, left));
+    // an O_DIRECT read past the end is cut short by the kernel, but its
+    // length still has to be aligned
+    if (direct_) slot.length = (slot.length + kAlignment - 1) / kAlignment * kAlignment;
+    nextOffset_ += kBufferBytes;
+    slot.queued = true;
+#ifdef WORDCOUNT_HAVE_IO_URING
+    if (ring_) {
+        auto index = static_cast<std::size_t>(&slot - slots_.data());
+        if (!ring_->push(fd_, index, slot.data, slot.length, slot.offset)) {
+            slot.queued = false;
+            return fail("io_uring_enter", errno);
+        }
+        return true;
+    }
+#endif
+    // pread() fallback: the kernel reads ahead what the ring will want
+    if (!direct_)
+        ::posix_fadvise(fd_, static_cast<off_t>(slot.offset), static_cast<off_t>(slot.length),
+                        POSIX_FADV_WILLNEED);
+    return true;
+}
+
+bool AsyncFileReader::complete(Slot& slot) {
+    std::uint64_t left = size_ - slot.offset;
+    std::size_t wanted = static_cast<std::size_t>(std::min<std::uint64_t>(slot.length, left));
+#ifdef WORDCOUNT_HAVE_IO_URING
+    if (ring_) {
+        while (!slot.done) {
+            // completions come in any order; each is filed with its slot
+            io_uring_cqe cqe;
+            if (!ring_->pop(cqe)) return fail("io_uring_enter", errno);
+            Slot& s = slots_[cqe.user_data];
+            if (cqe.res < 0) {
+                s.error = -cqe.res;
+                s.done = true;
+                continue;
+            }
+            s.filled += static_cast<std::size_t>(cqe.res);
+            std::size_t want = static_cast<std::size_t>(
+                std::min<std::uint64_t>(s.length, size_ - s.offset));
+            if (cqe.res == 0 || s.filled >= want) {
+                s.done = true;
+            } else if (!ring_->push(fd_, cqe.user_data, s.data + s.filled, s.length - s.filled,
+                                    s.offset + s.filled)) {
+                // a short read: the rest is queued again
+                s.done = true;
+                s.error = errno;
+            }
+        }
+        if (slot.error != 0) return fail("read", slot.error);
+        return true;
+    }
+#endif
+    while (slot.filled < wanted) {
+        ssize_t n = ::pread(fd_, slot.data + slot.filled, slot.length - slot.filled,
+                            static_cast<off_t>(slot.offset + slot.filled));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return fail("read", errno);
+        if (n == 0) break;
+        slot.filled += static_cast<std::size_t>(n);
+    }
+    slot.done = true;
+    return true;
+}
+
+bool AsyncFileReader::fail(const std::string& what, int error) {
+    if (error_.empty()) error_ = what + ": " + std::strerror(error);
+    return false;
+}
+
+void AsyncFileReader::close() {
+#ifdef WORDCOUNT_HAVE_IO_URING
+    // the kernel may still write into the buffers: wait for every read
+    // in flight before they are freed
+    if (ring_) {
+        for (auto& slot : slots_) {
+            while (slot.queued && !slot.done) {
+                io_uring_cqe cqe;
+                if (!ring_->pop(cqe)) break;
+                slots_[cqe.user_data].done = true;
+            }
+        }
+    }
+    ring_.reset();
+#endif
+    for (auto& slot : slots_) std::free(slot.data);
+    slots_.clear();
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    size_ = 0;
+    direct_ = false;
+    nextOffset_ = 0;
+    head_ = 0;
+    handedOut_ = false;
+    error_.clear();
+}
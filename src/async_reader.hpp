@@ -0,0 +1,86 @@
+// src/async_reader.hpp
+//
+// Sequential file reader that keeps the device busy. The file is read into
+// a ring of page-aligned buffers, one large read per buffer, and on Linux
+// every buffer's read is queued through io_uring at once: while the caller
+// copies one chunk out, the reads of all the others are in flight, so a
+// cold file is read at the device's queue depth instead of one request at
+// a time. A chunk handed out by next() is given back by the following call,
+// whose buffer then takes the next read of the file.
+//
+// With `direct`, the file is opened with O_DIRECT and bypasses the page
+// cache (every buffer, offset and length is aligned for it), which keeps a
+// one-pass scan of a huge input from evicting everything else. Where
+// io_uring isn't available (other systems, old kernels, or a sandbox that
+// forbids it) the same ring is filled with pread(), with posix_fadvise()
+// asking the kernel to read the next buffers ahead.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// true if the process may set up an io_uring here (tried once)
+bool ioUringAvailable();
+
+class AsyncFileReader {
+public:
+    AsyncFileReader();
+    ~AsyncFileReader();
+
+    AsyncFileReader(const AsyncFileReader&) = delete;
+    AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+    // Opens `path` and queues the first reads. If O_DIRECT is refused
+    // (e.g. by the filesystem), the file is read through the page cache
+    // instead. Returns false with a message in `error` if it can't be
+    // opened.
+    bool open(const std::string& path, bool direct, std::string& error);
+
+    // The next bytes of the file, in order; the view is valid until the
+    // next call. Returns false at the end of the file or on a read error
+    // (then error() says why).
+    bool next(std::string_view& chunk);
+
+    std::uint64_t size() const { return size_; }
+    bool direct() const { return direct_; }
+    // false if the ring is filled with pread() instead of io_uring
+    bool async() const { return ring_ != nullptr; }
+    const std::string& error() const { return error_; }
+
+    // the io_uring behind async(), defined in the .cpp
+    struct Ring;
+
+private:
+    struct Slot {
+        char* data = nullptr;      // kBufferBytes, page aligned
+        std::uint64_t offset = 0;  // of the read in the file
+        std::size_t length = 0;    // asked for (aligned for O_DIRECT)
+        std::size_t filled = 0;    // read so far
+        bool queued = false;       // holds a read of the file, in flight or done
+        bool done = false;
+        int error = 0;             // errno of a failed read
+    };
+
+    void close();
+    // queues the next read of the file into `slot`, if any is left
+    bool submit(Slot& slot);
+    // waits until `slot`'s read is complete (with io_uring, filing the
+    // completions of other slots on the way)
+    bool complete(Slot& slot);
+    bool fail(const std::string& what, int error);
+
+    int fd_ = -1;
+    std::uint64_t size_ = 0;
+    bool direct_ = false;
+    std::uint64_t nextOffset_ = 0;  // of the next read to queue
+    std::vector<Slot> slots_;
+    std::size_t head_ = 0;           // slot that holds the next chunk
+    bool handedOut_ = false;         // slots_[head_] is with the caller
+    std::unique_ptr<Ring> ring_;
+    std::string error_;
+};
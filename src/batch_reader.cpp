@@ -0,0 +1,379 @@
+// src/batch_reader.cpp
+
+#include "batch_reader.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+#include "async_reader.hpp"
+#include "log.hpp"
+#include "numa.hpp"
+#include "thread_pool.hpp"
+#include "tokenizer.hpp"
+
+namespace {
+// two batches are out of the queue at any time: one being mapped and one
+// being merged; packed input needs a buffer for each of them too
+constexpr std::size_t kBatchesInFlight = 2;
+constexpr std::size_t kPageSize = 4096;
+// files smaller than batchBytes / kPackDivisor are packed, not mapped
+constexpr std::size_t kPackDivisor = 16;
+// bytes asked of read() at a time for input that can't be mapped
+constexpr std::size_t kReadChunk = std::size_t(1) << 20;
+}
+
+BatchReader::BatchReader(std::vector<std::string> paths, std::size_t batchBytes, std::size_t depth,
+                         ThreadPool& pool, const ReaderOptions& options)
+    : batchBytes_(batchBytes), pool_(pool), options_(options), ready_(depth),
+      spare_(depth + kBatchesInFlight),
+      packLimit_(batchBytes) {
+    for (std::size_t i = 0; i < depth + kBatchesInFlight; ++i)
+        spare_.push({});
+    thread_ = std::thread([this, paths = std::move(paths)] {
+        pool_.unpinHelper();
+        auto start = std::chrono::steady_clock::now();
+        bool done = readInputs(paths);
+        // set before the close that lets next() return false
+        busy_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start) - blocked_;
+        if (done) ready_.close();
+    });
+}
+
+BatchReader::~BatchReader() {
+    // unblock the reader if we stop consuming early
+    ready_.close();
+    spare_.close();
+    thread_.join();
+}
+
+bool BatchReader::next(Batch& batch) {
+    return ready_.pop(batch);
+}
+
+void BatchReader::recycle(Batch&& batch) {
+    batch.mapping.reset();
+    if (batch.storage.capacity() == 0) return;  // mmap batch, nothing to reuse
+    batch.storage.clear();
+    spare_.push(std::move(batch.storage));
+}
+
+bool BatchReader::readInputs(const std::vector<std::string>& paths) {
+    for (auto const& path : paths) {
+        if (options_.asyncReads && path != "-") {
+            bool handled = false;
+            if (!readAsync(path, handled)) return false;
+            if (handled) {
+                packSeparator();
+                continue;
+            }
+        }
+        MappedFile file;
+        if (path != "-" && file.open(path)) {
+            Compression c = detectCompression(file.view().substr(0, 4));
+            bool open;
+            if (c != Compression::None) {
+                open = decodeMapped(file.view(), c, path);
+            } else if (file.size() >= batchBytes_ / kPackDivisor) {
+                // the packed input so far ends at a file boundary
+                open = emitPacked(true)
+                    && readMapped(std::make_shared<MappedFile>(std::move(file)));
+            } else {
+                open = packMapped(file.view());
+            }
+            if (!open) return false;
+            packSeparator();
+            continue;
+        }
+
+        // not mappable (stdin or a pipe, say): read it
+        int fd = path == "-" ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            fail(path, std::strerror(errno));
+            continue;
+        }
+        bool open = packFd(fd, path);
+        if (fd != STDIN_FILENO) ::close(fd);
+        if (!open) return false;
+        packSeparator();
+    }
+    return emitPacked(true);
+}
+
+bool BatchReader::readMapped(std::shared_ptr<const MappedFile> file) {
+    std::string_view mapped = file->view();
+    std::size_t pos = 0;
+    while (pos < mapped.size()) {
+        std::size_t end = nextWordBoundary(
+            mapped, std::min(pos + batchBytes_, mapped.size()));
+
+        // touch one byte per page so the I/O happens here rather than
+        // as page faults inside the map workers. the whole batch is asked
+        // for first, so a cold file is read with many requests in flight
+        // instead of one fault's readahead at a time; and the next batch
+        // is asked for before this one is queued, since the queue may
+        // keep the reader waiting
+        if (pos == 0) file->willNeed(pos, end - pos);
+        volatile char sink = 0;
+        for (std::size_t i = pos; i < end; i += kPageSize)
+            sink = sink ^ mapped[i];
+        file->willNeed(end, batchBytes_);
+
+        Batch batch;
+        batch.data = mapped.substr(pos, end - pos);
+        batch.inputBytes = batch.data.size();
+        batch.mapping = file;
+        if (!emit(std::move(batch))) return false;
+        pos = end;
+    }
+    return true;
+}
+
+bool BatchReader::readAsync(const std::string& path, bool& handled) {
+    // small files are packed from a mapping anyway, and anything that
+    // isn't a regular file (or fails to open) takes the usual path too
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)
+        || static_cast<std::size_t>(st.st_size) < batchBytes_ / kPackDivisor)
+        return true;
+    AsyncFileReader file;
+    std::string error;
+    if (!file.open(path, options_.directIo, error)) return true;
+    std::string_view chunk;
+    while (file.next(chunk)) {
+        // compressed input is decoded from a mapping, as before
+        if (!handled && detectCompression(chunk.substr(0, 4)) != Compression::None) return true;
+        handled = true;
+        // the reads of the ring's other buffers go on while this one is
+        // copied into the batch
+        if (!packMapped(chunk)) return false;
+    }
+    handled = true;
+    if (!file.error().empty()) fail(path, file.error());
+    return true;
+}
+
+bool BatchReader::packMapped(std::string_view bytes) {
+    while (!bytes.empty()) {
+        if (!ensurePacking()) return false;
+        std::size_t n = std::min(packLimit_ - packing_.size(), bytes.size());
+        packing_.insert(packing_.end(), bytes.begin(), bytes.begin() + n);
+        bytes.remove_prefix(n);
+        if (packing_.size() >= packLimit_ && !emitPacked(false)) return false;
+    }
+    return true;
+}
+
+bool BatchReader::packFd(int fd, const std::string& path) {
+    // read enough to recognise a compressed stream
+    std::vector<char> head(kReadChunk);
+    std::size_t filled = 0;
+    while (filled < 4) {
+        ssize_t n = ::read(fd, head.data() + filled, head.size() - filled);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            fail(path, std::strerror(errno));
+            return true;
+        }
+        if (n == 0) break;
+        filled += static_cast<std::size_t>(n);
+    }
+    std::string_view start(head.data(), filled);
+    Compression c = detectCompression(start);
+    if (c != Compression::None) {
+        auto decoder = makeDecoder(c);
+        if (!decoder) {
+            fail(path, std::string("built without ") + compressionName(c) + " support");
+            return true;
+        }
+        return packDecoded(*decoder, start, fd, path);
+    }
+    if (!packMapped(start)) return false;
+    if (filled == 0) return true;
+
+    for (;;) {
+        if (!ensurePacking()) return false;
+        std::size_t size = packing_.size();
+        std::size_t want = std::min(kReadChunk, packLimit_ - size);
+        packing_.resize(size + want);
+        ssize_t n = ::read(fd, packing_.data() + size, want);
+        packing_.resize(size + static_cast<std::size_t>(std::max<ssize_t>(n, 0)));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (n < 0) fail(path, std::strerror(errno));
+            return true;
+        }
+        if (packing_.size() >= packLimit_ && !emitPacked(false)) return false;
+    }
+}
+
+bool BatchReader::decodeMapped(std::string_view data, Compression c, const std::string& path) {
+    // independent frames with known sizes decode in parallel
+    std::vector<ZstdFrame> frames;
+    if (c == Compression::Zstd && splitZstdFrames(data, batchBytes_, frames) && frames.size() > 1)
+        return decodeFrames(frames, path);
+
+    auto decoder = makeDecoder(c);
+    if (!decoder) {
+        fail(path, std::string("built without ") + compressionName(c) + " support");
+        return true;
+    }
+    return packDecoded(*decoder, data, -1, path);
+}
+
+bool BatchReader::decodeFrames(const std::vector<ZstdFrame>& frames, const std::string& path) {
+    std::size_t next = 0;
+    while (next < frames.size()) {
+        // a window of frames that fits in one batch
+        std::size_t end = next, bytes = 0;
+        while (end < frames.size()
+               && (end == next || bytes + frames[end].plainSize <= batchBytes_))
+            bytes += frames[end++].plainSize;
+
+        if (!ensurePacking()) return false;
+        std::size_t at = packing_.size();
+        packing_.resize(at + bytes);
+        std::atomic<bool> ok{true};
+        {
+            TaskGroup tasks(pool_);
+            for (std::size_t i = next; i < end; ++i) {
+                char* out = packing_.data() + at;
+                tasks.run([&frames, &ok, i, out] {
+                    if (!decodeZstdFrame(frames[i], out)) ok.store(false);
+                });
+                at += frames[i].plainSize;
+            }
+            tasks.wait();
+        }
+        if (!ok.load()) {
+            packing_.resize(packing_.size() - bytes);
+            fail(path, "corrupt zstd data");
+            return true;
+        }
+        if (packing_.size() >= packLimit_ && !emitPacked(false)) return false;
+        next = end;
+    }
+    return true;
+}
+
+bool BatchReader::packDecoded(Decoder& decoder, std::string_view in, int fd,
+                              const std::string& path) {
+    // `in` is the whole input for a mapping (fd < 0), else what has been
+    // read so far; more is read into `input` as the decoder drains it
+    std::vector<char> input;
+    bool eof = fd < 0;
+    for (;;) {
+        if (in.empty() && !eof) {
+            input.resize(kReadChunk);
+            ssize_t n = ::read(fd, input.data(), input.size());
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                fail(path, std::strerror(errno));
+                return true;
+            }
+            if (n == 0) eof = true;
+            in = std::string_view(input.data(), static_cast<std::size_t>(n));
+        }
+
+        if (!ensurePacking()) return false;
+        std::size_t size = packing_.size();
+        std::size_t want = std::min(kReadChunk, packLimit_ - size);
+        packing_.resize(size + want);
+        std::size_t before = in.size(), produced = 0;
+        bool ok = decoder.decode(in, packing_.data() + size, want, produced);
+        packing_.resize(size + produced);
+        if (!ok) {
+            fail(path, "corrupt compressed data");
+            return true;
+        }
+        if (packing_.size() >= packLimit_ && !emitPacked(false)) return false;
+
+        if (produced == 0 && in.size() == before) {
+            if (!in.empty()) {
+                fail(path, "corrupt compressed data");
+                return true;
+            }
+            if (eof) break;
+        }
+    }
+    if (!decoder.complete()) fail(path, "truncated compressed data");
+    return true;
+}
+
+void BatchReader::packSeparator() {
+    // ends the file just packed, so its last word can't run into the next
+    // file's first; wherever that word currently sits
+    if (havePacking_) {
+        if (packing_.empty()) return;
+        packing_.push_back('\n');
+    } else if (!carry_.empty()) {
+        carry_.push_back('\n');
+    } else {
+        return;
+    }
+    ++separators_;
+}
+
+bool BatchReader::ensurePacking() {
+    if (havePacking_) return true;
+    auto wait = std::chrono::steady_clock::now();
+    bool free = spare_.pop(packing_);
+    blocked_ += std::chrono::steady_clock::now() - wait;
+    if (!free) return false;
+    packing_.clear();
+    packing_.reserve(std::max(packLimit_, carry_.size()) + 1);
+    packing_.insert(packing_.end(), carry_.begin(), carry_.end());
+    carry_.clear();
+    // a long word carried over still leaves room for a batch after it
+    if (packing_.size() >= packLimit_) packLimit_ = packing_.size() + batchBytes_;
+    havePacking_ = true;
+    return true;
+}
+
+bool BatchReader::emitPacked(bool final) {
+    if (!havePacking_ && !carry_.empty() && !ensurePacking()) return false;
+    if (!havePacking_ || packing_.empty()) return true;
+    std::string_view data(packing_.data(), packing_.size());
+    std::size_t cut = final ? data.size() : lastWordBoundary(data);
+    if (cut == 0) {
+        // nothing complete yet (one giant word); keep filling this buffer
+        packLimit_ *= 2;
+        return true;
+    }
+    packLimit_ = batchBytes_;
+    // the trailing partial word moves to the next buffer
+    carry_.assign(packing_.begin() + cut, packing_.end());
+
+    Batch batch;
+    batch.data = data.substr(0, cut);
+    // a separator isn't a word byte, so none is in the carried-over part
+    batch.inputBytes = cut - separators_;
+    separators_ = 0;
+    batch.storage = std::move(packing_);
+    havePacking_ = false;
+    return emit(std::move(batch));
+}
+
+bool BatchReader::emit(Batch&& batch) {
+    batch.offset = offset_;
+    offset_ += batch.data.size();
+    trace("[Read] batch of bytes {}–{} ready", batch.offset, offset_);
+    auto wait = std::chrono::steady_clock::now();
+    bool queued = ready_.push(std::move(batch));
+    blocked_ += std::chrono::steady_clock::now() - wait;
+    return queued;
+}
+
+void BatchReader::fail(const std::string& path, const std::string& reason) {
+    if (failed()) return;
+    failure_ = path + ": " + reason;
+    failed_.store(true, std::memory_order_release);
+}
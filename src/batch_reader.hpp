@@ -0,0 +1,121 @@
+// src/batch_reader.hpp
+//
+// Reader stage of the pipeline. A dedicated thread cuts the input into
+// word-aligned batches of about batchBytes and queues them, so reading
+// batch N+1 overlaps with counting batch N and merging batch N-1. At most
+// `depth` batches wait in the queue, which caps memory use.
+//
+// The input is a list of files read in order. A large regular file is
+// mapped and cut into batches that are views of the mapping. Smaller files,
+// and inputs that cannot be mapped (pipes), are copied into recycled
+// buffers and packed several to a batch, with a newline between files so
+// no word spans two of them. Either way every batch is one contiguous
+// range that the map phase splits across threads by bytes.
+//
+// The path "-" reads standard input. Compressed inputs (gzip, bzip2, zstd)
+// are recognised by their first bytes and decoded into packed buffers on
+// the way in; a mapped zstd file made of several frames is decoded frame
+// by frame on the pool, in parallel.
+//
+// With ReaderOptions::asyncReads, a large plain file is not mapped but read
+// through an AsyncFileReader (io_uring, optionally O_DIRECT) and packed:
+// for cold files, where page faults would read one readahead window at a
+// time.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hpp"
+#include "decompress.hpp"
+#include "mapped_file.hpp"
+
+class ThreadPool;
+
+struct ReaderOptions {
+    bool asyncReads = false;  // read large files with AsyncFileReader, not mmap
+    bool directIo = false;    // and bypass the page cache (O_DIRECT)
+};
+
+struct Batch {
+    std::string_view data;    // word-aligned bytes to count
+    std::size_t offset = 0;   // position of data in the whole input
+    // bytes of data read (or decoded) from the inputs: data without the
+    // newlines packed between files
+    std::size_t inputBytes = 0;
+    std::vector<char> storage; // owns the bytes of packed input, empty for mmap
+    std::shared_ptr<const MappedFile> mapping;  // keeps a mapped file alive
+};
+
+class BatchReader {
+public:
+    // `pool` decodes independent zstd frames in parallel
+    BatchReader(std::vector<std::string> paths, std::size_t batchBytes, std::size_t depth,
+                ThreadPool& pool, const ReaderOptions& options = {});
+    ~BatchReader();
+
+    BatchReader(const BatchReader&) = delete;
+    BatchReader& operator=(const BatchReader&) = delete;
+
+    // Blocks until the next batch is ready. Returns false at end of input.
+    bool next(Batch& batch);
+
+    // Hands a fully processed batch back so its buffer can be reused.
+    void recycle(Batch&& batch);
+
+    // true if an input could not be opened, read or decoded; the reader
+    // skips the rest of it and goes on with the next one
+    bool failed() const { return failed_.load(std::memory_order_acquire); }
+    // "path: reason" for the first input that failed; only valid once
+    // failed() is true
+    const std::string& failure() const { return failure_; }
+
+    // time the reader thread spent reading, decoding and copying input,
+    // not counting waits for queue room or a free buffer; only valid once
+    // next() has returned false
+    std::chrono::nanoseconds busyTime() const { return busy_; }
+
+private:
+    bool readInputs(const std::vector<std::string>& paths);
+    bool readMapped(std::shared_ptr<const MappedFile> file);
+    // a large plain file through AsyncFileReader; `handled` stays false
+    // for any other file, which is then read as usual
+    bool readAsync(const std::string& path, bool& handled);
+    bool packMapped(std::string_view bytes);
+    bool packFd(int fd, const std::string& path);
+    bool decodeMapped(std::string_view data, Compression c, const std::string& path);
+    bool decodeFrames(const std::vector<ZstdFrame>& frames, const std::string& path);
+    bool packDecoded(Decoder& decoder, std::string_view in, int fd, const std::string& path);
+    void packSeparator();
+    bool ensurePacking();
+    bool emitPacked(bool final);
+    bool emit(Batch&& batch);
+    void fail(const std::string& path, const std::string& reason);
+
+    std::size_t batchBytes_;
+    ThreadPool& pool_;
+    ReaderOptions options_;
+    BoundedQueue<Batch> ready_;
+    BoundedQueue<std::vector<char>> spare_;
+    std::atomic<bool> failed_{false};
+    std::string failure_;
+
+    // reader thread only
+    std::vector<char> packing_;   // buffer being filled with small inputs
+    bool havePacking_ = false;
+    std::size_t packLimit_;       // packed size at which a batch is cut
+    std::vector<char> carry_;     // partial word at the end of the last batch
+    std::size_t separators_ = 0;  // newlines packed between files, not yet emitted
+    std::size_t offset_ = 0;      // bytes handed out so far
+    std::chrono::nanoseconds blocked_{0};  // waiting on ready_ or spare_
+    std::chrono::nanoseconds busy_{0};
+
+    std::thread thread_;
+};
@@ -0,0 +1,57 @@
+// src/bounded_queue.hpp
+//
+// Fixed-capacity blocking queue connecting pipeline stages. push() blocks
+// while the queue is full, which is what keeps a fast producer from
+// running ahead and growing memory without limit.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(std::size_t capacity) : capacity_(capacity ? capacity : 1) {}
+
+    // Returns false if the queue was closed before there was room.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lk(mutex_);
+        notFull_.wait(lk, [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    // Blocks until an item is available. Returns false once the queue is
+    // closed and drained.
+    bool pop(T& out) {
+        std::unique_lock<std::mutex> lk(mutex_);
+        notEmpty_.wait(lk, [this] { return closed_ || !items_.empty(); });
+        if (items_.empty()) return false;
+        out = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    // No more pushes; consumers drain what is left.
+    void close() {
+        std::lock_guard<std::mutex> lg(mutex_);
+        closed_ = true;
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+
+private:
+    std::size_t capacity_;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+    bool closed_ = false;
+};
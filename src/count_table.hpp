@@ -0,0 +1,153 @@
+// src/count_table.hpp
+//
+// Flat open-addressing word -> count table used by both the map and the
+// reduce phase. Slots are one contiguous array (linear probing, stored
+// hash, inline count) and keys are string_views: either into the table's
+// own Arena, or, for a table that borrows its keys, straight into input
+// bytes that outlive it. An insert costs no per-entry heap node and no
+// per-word malloc, and clear() is one slot wipe plus one arena reset.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "arena.hpp"
+#include "word_hash.hpp"
+
+class CountTable {
+public:
+    // A table that borrows its keys stores views of the caller's bytes
+    // instead of copying them; the caller keeps those bytes alive until
+    // the table is cleared. The map phase does this with batch data, which
+    // is only released after the batch has been merged.
+    explicit CountTable(std::size_t expected = 0, bool borrowKeys = false)
+        : borrowKeys_(borrowKeys) { reserve(expected); }
+
+    // the word hash of word_hash.hpp, the same in every table of a run
+    static std::uint64_t hashOf(std::string_view key) { return wordHash(key); }
+
+    void add(std::string_view key, std::size_t count = 1) {
+        add(key, hashOf(key), count);
+    }
+
+    void add(std::string_view key, std::uint64_t hash, std::size_t count) {
+        insert(key, hash, count, borrowKeys_);
+    }
+
+    // like add(), but always copies a new key, even for a table that
+    // borrows its keys; for words that only exist in a scratch buffer
+    void addTransient(std::string_view key, std::size_t count = 1) {
+        insert(key, hashOf(key), count, false);
+    }
+
+    // the count of `key`, 0 if it has no entry; for a table used as a set
+    // or a map, which is only read while it is shared
+    std::uint64_t find(std::string_view key) const {
+        if (size_ == 0) return 0;
+        std::uint64_t hash = hashOf(key);
+        std::size_t mask = slots_.size() - 1;
+        for (std::size_t i = slotFor(hash); slots_[i].count != 0; i = (i + 1) & mask)
+            if (slots_[i].hash == hash && slots_[i].keyLength == key.size()
+                && std::memcmp(slots_[i].key, key.data(), key.size()) == 0)
+                return slots_[i].count;
+        return 0;
+    }
+    bool contains(std::string_view key) const { return find(key) != 0; }
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // Memory the current entries need: their slots at the load limit plus
+    // their copied keys. Capacity kept by clear() is not counted, since it
+    // is reused before the table allocates anything new.
+    std::size_t bytesInUse() const {
+        return size_ * sizeof(Slot) * 10 / 7 + keys_.used();
+    }
+
+    // makes room for `expected` entries without growing
+    void reserve(std::size_t expected) {
+        std::size_t want = 16;
+        while (want * 7 < expected * 10) want <<= 1;
+        if (want > slots_.size()) rehash(want);
+    }
+
+    // drops all entries but keeps the allocated capacity
+    void clear() {
+        if (size_ == 0) return;
+        std::fill(slots_.begin(), slots_.end(), Slot{});
+        keys_.reset();
+        size_ = 0;
+    }
+
+    // calls f(key, count, hash) for every entry, in table order
+    template<typename F>
+    void forEach(F&& f) const {
+        for (auto const& s : slots_)
+            if (s.count != 0)
+                f(std::string_view(s.key, s.keyLength), s.count, s.hash);
+    }
+
+private:
+    void insert(std::string_view key, std::uint64_t hash, std::size_t count, bool borrow) {
+        if ((size_ + 1) * 10 > slots_.size() * 7)  // keep load <= 0.7
+            grow();
+        std::size_t mask = slots_.size() - 1;
+        for (std::size_t i = slotFor(hash);; i = (i + 1) & mask) {
+            Slot& s = slots_[i];
+            if (s.count == 0) {
+                s.hash = hash;
+                s.count = count;
+                std::string_view stored = borrow ? key : keys_.store(key);
+                s.key = stored.data();
+                s.keyLength = static_cast<std::uint32_t>(stored.size());
+                ++size_;
+                return;
+            }
+            if (s.hash == hash && s.keyLength == key.size()
+                && std::memcmp(s.key, key.data(), key.size()) == 0) {
+                s.count += count;
+                return;
+            }
+        }
+    }
+
+    struct Slot {
+        std::uint64_t hash = 0;
+        std::uint64_t count = 0;      // 0 marks an empty slot
+        const char* key = nullptr;    // into keys_ or the borrowed input
+        std::uint32_t keyLength = 0;
+    };
+
+    // Fibonacci hashing: take the top bits of hash * 2^64/phi, so the slot
+    // index does not depend on the low bits callers may use for sharding
+    std::size_t slotFor(std::uint64_t hash) const {
+        return static_cast<std::size_t>((hash * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+
+    void grow() { rehash(slots_.empty() ? 16 : slots_.size() * 2); }
+
+    void rehash(std::size_t capacity) {
+        std::vector<Slot> old(capacity);
+        old.swap(slots_);
+        shift_ = 64;
+        for (std::size_t c = capacity; c > 1; c >>= 1) --shift_;
+        std::size_t mask = capacity - 1;
+        for (auto const& s : old) {
+            if (s.count == 0) continue;
+            std::size_t i = slotFor(s.hash);
+            while (slots_[i].count != 0) i = (i + 1) & mask;
+            slots_[i] = s;
+        }
+    }
+
+    std::vector<Slot> slots_;
+    Arena keys_;
+    bool borrowKeys_;
+    std::size_t size_ = 0;
+    unsigned shift_ = 64;
+};
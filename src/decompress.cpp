@@ -0,0 +1,194 @@
+// src/decompress.cpp
+
+#include "decompress.hpp"
+
+#include <algorithm>
+
+#ifdef WORDCOUNT_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef WORDCOUNT_HAVE_BZIP2
+#include <bzlib.h>
+#endif
+#ifdef WORDCOUNT_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+// zlib and bzip2 count buffer sizes in 32-bit unsigned ints
+constexpr std::size_t kMaxStep = std::size_t(1) << 30;
+
+#ifdef WORDCOUNT_HAVE_ZLIB
+class GzipDecoder : public Decoder {
+public:
+    GzipDecoder() { ok_ = inflateInit2(&z_, 15 + 16) == Z_OK; }  // gzip wrapper only
+    ~GzipDecoder() override { if (ok_) inflateEnd(&z_); }
+
+    bool decode(std::string_view& in, char* out, std::size_t capacity,
+                std::size_t& produced) override {
+        produced = 0;
+        if (!ok_) return false;
+        if (ended_) {
+            if (in.empty()) return true;
+            inflateReset(&z_);  // another member follows
+            ended_ = false;
+        }
+        std::size_t inStep = std::min(in.size(), kMaxStep);
+        std::size_t outStep = std::min(capacity, kMaxStep);
+        z_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+        z_.avail_in = static_cast<uInt>(inStep);
+        z_.next_out = reinterpret_cast<Bytef*>(out);
+        z_.avail_out = static_cast<uInt>(outStep);
+        int rc = inflate(&z_, Z_NO_FLUSH);
+        in.remove_prefix(inStep - z_.avail_in);
+        produced = outStep - z_.avail_out;
+        if (rc == Z_STREAM_END) ended_ = true;
+        return rc == Z_OK || rc == Z_STREAM_END || rc == Z_BUF_ERROR;
+    }
+
+    bool complete() const override { return ended_; }
+
+private:
+    z_stream z_{};
+    bool ok_ = false;
+    bool ended_ = false;
+};
+#endif
+
+#ifdef WORDCOUNT_HAVE_BZIP2
+class Bzip2Decoder : public Decoder {
+public:
+    Bzip2Decoder() { ok_ = BZ2_bzDecompressInit(&s_, 0, 0) == BZ_OK; }
+    ~Bzip2Decoder() override { if (ok_) BZ2_bzDecompressEnd(&s_); }
+
+    bool decode(std::string_view& in, char* out, std::size_t capacity,
+                std::size_t& produced) override {
+        produced = 0;
+        if (ended_) {
+            if (in.empty()) return true;
+            // another stream follows (pbzip2 writes one per block)
+            BZ2_bzDecompressEnd(&s_);
+            s_ = bz_stream{};
+            ok_ = BZ2_bzDecompressInit(&s_, 0, 0) == BZ_OK;
+            ended_ = false;
+        }
+        if (!ok_) return false;
+        std::size_t inStep = std::min(in.size(), kMaxStep);
+        std::size_t outStep = std::min(capacity, kMaxStep);
+        s_.next_in = const_cast<char*>(in.data());
+        s_.avail_in = static_cast<unsigned int>(inStep);
+        s_.next_out = out;
+        s_.avail_out = static_cast<unsigned int>(outStep);
+        int rc = BZ2_bzDecompress(&s_);
+        in.remove_prefix(inStep - s_.avail_in);
+        produced = outStep - s_.avail_out;
+        if (rc == BZ_STREAM_END) ended_ = true;
+        return rc == BZ_OK || rc == BZ_STREAM_END;
+    }
+
+    bool complete() const override { return ended_; }
+
+private:
+    bz_stream s_{};
+    bool ok_ = false;
+    bool ended_ = false;
+};
+#endif
+
+#ifdef WORDCOUNT_HAVE_ZSTD
+class ZstdDecoder : public Decoder {
+public:
+    ZstdDecoder() : ctx_(ZSTD_createDCtx()) {}
+    ~ZstdDecoder() override { ZSTD_freeDCtx(ctx_); }
+
+    bool decode(std::string_view& in, char* out, std::size_t capacity,
+                std::size_t& produced) override {
+        produced = 0;
+        if (!ctx_) return false;
+        ZSTD_inBuffer input{in.data(), in.size(), 0};
+        ZSTD_outBuffer output{out, capacity, 0};
+        std::size_t rc = ZSTD_decompressStream(ctx_, &output, &input);
+        in.remove_prefix(input.pos);
+        produced = output.pos;
+        if (ZSTD_isError(rc)) return false;
+        // 0: a frame ended and everything it decoded has been returned
+        if (input.pos > 0 || output.pos > 0) complete_ = rc == 0;
+        return true;
+    }
+
+    bool complete() const override { return complete_; }
+
+private:
+    ZSTD_DCtx* ctx_;
+    bool complete_ = true;  // nothing started yet
+};
+#endif
+
+}  // namespace
+
+Compression detectCompression(std::string_view head) {
+    auto starts = [&](std::string_view magic) { return head.substr(0, magic.size()) == magic; };
+    if (starts("\x1f\x8b")) return Compression::Gzip;
+    if (starts("BZh")) return Compression::Bzip2;
+    if (starts("\x28\xb5\x2f\xfd")) return Compression::Zstd;
+    return Compression::None;
+}
+
+const char* compressionName(Compression c) {
+    switch (c) {
+    case Compression::Gzip:  return "gzip";
+    case Compression::Bzip2: return "bzip2";
+    case Compression::Zstd:  return "zstd";
+    case Compression::None:  break;
+    }
+    return "uncompressed";
+}
+
+std::unique_ptr<Decoder> makeDecoder(Compression c) {
+    switch (c) {
+#ifdef WORDCOUNT_HAVE_ZLIB
+    case Compression::Gzip:  return std::make_unique<GzipDecoder>();
+#endif
+#ifdef WORDCOUNT_HAVE_BZIP2
+    case Compression::Bzip2: return std::make_unique<Bzip2Decoder>();
+#endif
+#ifdef WORDCOUNT_HAVE_ZSTD
+    case Compression::Zstd:  return std::make_unique<ZstdDecoder>();
+#endif
+    default:                 return nullptr;
+    }
+}
+
+bool splitZstdFrames(std::string_view data, std::size_t maxPlainSize,
+                     std::vector<ZstdFrame>& frames) {
+    frames.clear();
+#ifdef WORDCOUNT_HAVE_ZSTD
+    while (!data.empty()) {
+        std::size_t size = ZSTD_findFrameCompressedSize(data.data(), data.size());
+        if (ZSTD_isError(size)) return false;
+        unsigned long long plain = ZSTD_getFrameContentSize(data.data(), size);
+        if (plain == ZSTD_CONTENTSIZE_UNKNOWN || plain == ZSTD_CONTENTSIZE_ERROR
+            || plain > maxPlainSize)
+            return false;
+        frames.push_back({data.substr(0, size), static_cast<std::size_t>(plain)});
+        data.remove_prefix(size);
+    }
+    return true;
+#else
+    (void)data;
+    (void)maxPlainSize;
+    return false;
+#endif
+}
+
+bool decodeZstdFrame(const ZstdFrame& frame, char* out) {
+#ifdef WORDCOUNT_HAVE_ZSTD
+    std::size_t rc = ZSTD_decompress(out, frame.plainSize, frame.bytes.data(), frame.bytes.size());
+    return !ZSTD_isError(rc) && rc == frame.plainSize;
+#else
+    (void)frame;
+    (void)out;
+    return false;
+#endif
+}
@@ -0,0 +1,58 @@
+// src/decompress.hpp
+//
+// Decoders for compressed input. The format is detected from the first
+// bytes of each input, not from its name, so compressed data on a pipe
+// works too. gzip (zlib), bzip2 and zstd decoding are each compiled in
+// when CMake finds the library (WORDCOUNT_HAVE_ZLIB, WORDCOUNT_HAVE_BZIP2,
+// WORDCOUNT_HAVE_ZSTD); an input in a format that was left out is
+// reported as an error.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+enum class Compression { None, Gzip, Bzip2, Zstd };
+
+// format of an input starting with `head` (the first 4 bytes suffice)
+Compression detectCompression(std::string_view head);
+const char* compressionName(Compression c);
+
+// Incremental decoder for one input; concatenated gzip members, bzip2
+// streams and zstd frames are decoded as one stream.
+class Decoder {
+public:
+    virtual ~Decoder() = default;
+
+    // Decodes from the front of `in` into out[0, capacity), advancing `in`
+    // past the consumed bytes and setting `produced`. May consume input
+    // without producing anything, or keep output buffered for later calls.
+    // Returns false if the data is corrupt.
+    virtual bool decode(std::string_view& in, char* out, std::size_t capacity,
+                        std::size_t& produced) = 0;
+
+    // true if the input seen so far ends on a complete member/frame
+    virtual bool complete() const = 0;
+};
+
+// nullptr if `c` is None or was not compiled in
+std::unique_ptr<Decoder> makeDecoder(Compression c);
+
+// One zstd frame of a mapped file and the size it decodes to.
+struct ZstdFrame {
+    std::string_view bytes;
+    std::size_t plainSize;
+};
+
+// Splits a whole zstd input into its frames. Returns false, and the input
+// must be decoded as a stream, if a frame does not record its decoded size,
+// if decoding any frame alone would need more than `maxPlainSize` bytes or
+// if zstd was not compiled in.
+bool splitZstdFrames(std::string_view data, std::size_t maxPlainSize,
+                     std::vector<ZstdFrame>& frames);
+
+// Decodes one frame from splitZstdFrames into out[0, frame.plainSize).
+// Frames are independent, so they can be decoded on different threads.
+bool decodeZstdFrame(const ZstdFrame& frame, char* out);
@@ -0,0 +1,127 @@
+// src/hot_word_cache.hpp
+//
+// Hot-word fast path in front of a map thread's CountTable. Word counts
+// follow Zipf's law, so a few thousand short words ("ja", "on", "oli", ...)
+// make up most of all adds. For a word of up to 8 bytes the cache packs the
+// bytes into one integer, picks a slot of a direct-mapped array (256 KiB,
+// small enough to stay in L2) with one multiply, and compares the slot's
+// word as a single integer: a hit costs no string hash, no memcmp and no
+// probe of the big table, whose slots are spread over megabytes. Pending
+// counts are added to the table when their entry is evicted and by flush()
+// at the end of every chunk, before the table is partitioned.
+//
+// Longer words and misses go to the table as usual. A missing word only
+// replaces the resident word of its slot once that slot has missed more
+// often than the resident has hit, so a stream of rare words can't push
+// out a hot one. If after a trial period within a chunk too few adds hit
+// (text with a flat vocabulary), the cache switches itself off for the
+// rest of that chunk and every add goes straight to the table.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "count_table.hpp"
+
+class HotWordCache {
+public:
+    // adds into `table`, which must borrow its keys (cached keys are views
+    // of the same input the table would be given)
+    explicit HotWordCache(CountTable& table) : table_(&table), entries_(kEntries) {}
+
+    void add(std::string_view key) {
+        if (!enabled_ || key.size() > 8) {
+            table_->add(key);
+            return;
+        }
+        ++adds_;
+        std::uint64_t packed = pack(key);
+        Entry& e = entries_[((packed + key.size()) * 0x9E3779B97F4A7C15ull) >> kIndexShift];
+        if (e.packed == packed && e.length == key.size()) {
+            ++e.count;
+            ++hits_;
+            return;
+        }
+        table_->add(key);
+        if (++e.misses > e.count) {
+            if (e.count != 0) table_->add(std::string_view(e.key, e.length), e.count);
+            e = {packed, key.data(), static_cast<std::uint32_t>(key.size()), 0, 0};
+        }
+        if (!trialOver_ && adds_ >= kTrialAdds) {
+            trialOver_ = true;
+            if (hits_ * kMinHitShare < adds_) {
+                drain();
+                enabled_ = false;
+            }
+        }
+    }
+
+    // a word only in a scratch buffer can't be cached by view; the table
+    // copies it
+    void addTransient(std::string_view key) { table_->addTransient(key); }
+
+    // Moves every pending count into the table and forgets the cached
+    // words, whose input may be released; the next chunk starts a new trial.
+    void flush() {
+        if (enabled_) drain();
+        adds_ = hits_ = 0;
+        trialOver_ = false;
+        enabled_ = true;
+    }
+
+    // the bytes of a word of at most 8 bytes as one integer, zero-padded.
+    // an 8-byte load that stays within the word's page can't fault, so it
+    // is only split up near a page end. the sanitizers check the bytes
+    // past the word too, and the mask below assumes little-endian order
+    static std::uint64_t pack(std::string_view key) {
+        std::uint64_t word = 0;
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__) \
+    || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+        std::memcpy(&word, key.data(), key.size());
+#else
+        constexpr std::uintptr_t kPage = 4096;
+        if ((reinterpret_cast<std::uintptr_t>(key.data()) & (kPage - 1)) <= kPage - 8) {
+            std::memcpy(&word, key.data(), 8);
+            if (key.size() < 8) word &= ~std::uint64_t(0) >> (64 - 8 * key.size());
+        } else {
+            std::memcpy(&word, key.data(), key.size());
+        }
+#endif
+        return word;
+    }
+
+private:
+    static constexpr unsigned kIndexBits = 13;
+    static constexpr std::size_t kEntries = std::size_t(1) << kIndexBits;
+    static constexpr unsigned kIndexShift = 64 - kIndexBits;
+    static constexpr std::uint64_t kTrialAdds = 1 << 16;
+    // keep the cache if at least 1 in kMinHitShare adds hit during the trial
+    static constexpr std::uint64_t kMinHitShare = 4;
+
+    struct Entry {
+        std::uint64_t packed = 0;
+        const char* key = nullptr;
+        std::uint32_t length = 0;  // 0 marks an empty entry; words aren't empty
+        std::uint32_t misses = 0;  // adds that hit this slot but not its word
+        std::uint64_t count = 0;   // not yet in the table
+    };
+
+    void drain() {
+        for (auto& e : entries_) {
+            if (e.count != 0) table_->add(std::string_view(e.key, e.length), e.count);
+            e = Entry{};
+        }
+    }
+
+
+    CountTable* table_;
+    std::vector<Entry> entries_;
+    std::uint64_t adds_ = 0;
+    std::uint64_t hits_ = 0;
+    bool trialOver_ = false;
+    bool enabled_ = true;
+};
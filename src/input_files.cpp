@@ -0,0 +1,76 @@
+// src/input_files.cpp
+
+#include "input_files.hpp"
+
+#include <glob.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool isGlobPattern(const std::string& arg) {
+    return arg.find_first_of("*?[") != std::string::npos;
+}
+
+bool addDirectory(const fs::path& dir, std::vector<std::string>& files, std::string& error) {
+    std::vector<std::string> found;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code typeError;
+        if (it->is_regular_file(typeError))
+            found.push_back(it->path().string());
+    }
+    if (ec) {
+        error = "could not read directory " + dir.string() + ": " + ec.message();
+        return false;
+    }
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+    return true;
+}
+
+bool addPath(const std::string& path, std::vector<std::string>& files, std::string& error) {
+    std::error_code ec;
+    if (fs::is_directory(path, ec))
+        return addDirectory(path, files, error);
+    files.push_back(path);
+    return true;
+}
+
+}  // namespace
+
+bool expandInputs(const std::vector<std::string>& args, std::vector<std::string>& files,
+                  std::string& error) {
+    files.clear();
+    for (auto const& arg : args) {
+        if (arg == "-") {  // standard input
+            files.push_back(arg);
+            continue;
+        }
+        std::error_code ec;
+        if (fs::exists(arg, ec)) {
+            if (!addPath(arg, files, error)) return false;
+            continue;
+        }
+        if (!isGlobPattern(arg)) {
+            error = "no such input file: " + arg;
+            return false;
+        }
+        glob_t matches{};
+        if (::glob(arg.c_str(), 0, nullptr, &matches) != 0) {
+            ::globfree(&matches);
+            error = "no input files match " + arg;
+            return false;
+        }
+        bool ok = true;
+        for (std::size_t i = 0; i < matches.gl_pathc && ok; ++i)
+            ok = addPath(matches.gl_pathv[i], files, error);
+        ::globfree(&matches);
+        if (!ok) return false;
+    }
+    return true;
+}
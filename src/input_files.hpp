@@ -0,0 +1,18 @@
+// src/input_files.hpp
+//
+// Turns the input arguments into the list of files the reader goes
+// through, in order. Expansion happens once, up front, so a missing input
+// is reported before any counting starts.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// A directory stands for every regular file below it, sorted by path. An
+// argument that names nothing but contains *, ? or [ is a glob pattern,
+// also expanded in sorted order (for shells that left it quoted). "-" is
+// standard input. Anything else must exist and is kept as is, so pipes
+// work too. On failure returns false with a message in `error`.
+bool expandInputs(const std::vector<std::string>& args, std::vector<std::string>& files,
+                  std::string& error);
@@ -0,0 +1,110 @@
+// src/log.cpp
+
+#include "log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// events kept per thread; older ones are overwritten
+constexpr std::size_t kRingEvents = 8192;
+
+struct Event {
+    std::int64_t ns;
+    const char* format;
+    std::uint64_t a, b;
+};
+
+struct Ring {
+    unsigned int thread = 0;   // order in which threads first recorded
+    std::uint64_t recorded = 0;
+    Event events[kRingEvents];
+};
+
+// rings belong to the registry, so they outlive the threads that fill them;
+// the lock is taken once per thread, when it records its first event
+std::mutex registryMutex;
+std::vector<std::unique_ptr<Ring>> rings;
+thread_local Ring* tlsRing = nullptr;
+
+std::ostream discard(nullptr);
+
+void print(std::ostream& out, const Event& e, std::int64_t origin, unsigned int thread) {
+    char stamp[32];
+    std::snprintf(stamp, sizeof stamp, "[%10.3f ms] ", (e.ns - origin) / 1e6);
+    out << stamp << "thread " << thread << ": ";
+    std::uint64_t args[2] = {e.a, e.b};
+    unsigned int used = 0;
+    for (const char* p = e.format; *p; ++p) {
+        if (p[0] == '{' && p[1] == '}' && used < 2) {
+            out << args[used++];
+            ++p;
+        } else {
+            out << *p;
+        }
+    }
+    out << "\n";
+}
+
+}  // namespace
+
+namespace log_detail {
+
+std::atomic<LogLevel> level{LogLevel::Info};
+
+void record(const char* format, std::uint64_t a, std::uint64_t b) {
+    if (!tlsRing) {
+        auto ring = std::make_unique<Ring>();
+        std::lock_guard<std::mutex> lg(registryMutex);
+        ring->thread = static_cast<unsigned int>(rings.size());
+        tlsRing = ring.get();
+        rings.push_back(std::move(ring));
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now().time_since_epoch()).count();
+    tlsRing->events[tlsRing->recorded % kRingEvents] = {ns, format, a, b};
+    ++tlsRing->recorded;
+}
+
+}  // namespace log_detail
+
+void setLogLevel(LogLevel level) {
+    log_detail::level.store(level, std::memory_order_relaxed);
+}
+
+std::ostream& logAt(LogLevel level) {
+    // stdout is left to --metrics, so it can be parsed
+    return logEnabled(level) ? std::cerr : discard;
+}
+
+void flushTrace(std::ostream& out) {
+    std::lock_guard<std::mutex> lg(registryMutex);
+    struct Entry {
+        const Event* event;
+        unsigned int thread;
+    };
+    std::vector<Entry> entries;
+    std::uint64_t dropped = 0;
+    for (auto const& ring : rings) {
+        std::uint64_t kept = std::min<std::uint64_t>(ring->recorded, kRingEvents);
+        dropped += ring->recorded - kept;
+        for (std::uint64_t i = ring->recorded - kept; i < ring->recorded; ++i)
+            entries.push_back({&ring->events[i % kRingEvents], ring->thread});
+    }
+    if (entries.empty()) return;
+    std::stable_sort(entries.begin(), entries.end(), [](Entry const& x, Entry const& y) {
+        return x.event->ns < y.event->ns;
+    });
+
+    out << "\n--- Trace ---\n";
+    if (dropped != 0) out << "(" << dropped << " earlier events were overwritten)\n";
+    std::int64_t origin = entries.front().event->ns;
+    for (auto const& e : entries) print(out, *e.event, origin, e.thread);
+    for (auto const& ring : rings) ring->recorded = 0;
+}
@@ -0,0 +1,42 @@
+// src/log.hpp
+//
+// Levelled logging, to stderr. Messages at Info and above are written by
+// the main thread as they happen. Trace messages come from the pool threads, so
+// they must not serialise the workers on a lock or a terminal: each thread
+// records them in its own fixed-size ring buffer (a timestamp, a format
+// literal and two numbers, no formatting) and flushTrace() prints all of
+// them, merged in time order, once the run is over. Below Trace, recording
+// is a single relaxed load.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+enum class LogLevel { Error, Info, Trace };
+
+namespace log_detail {
+extern std::atomic<LogLevel> level;
+void record(const char* format, std::uint64_t a, std::uint64_t b);
+}  // namespace log_detail
+
+void setLogLevel(LogLevel level);
+
+inline bool logEnabled(LogLevel level) {
+    return level <= log_detail::level.load(std::memory_order_relaxed);
+}
+
+// stream for a main-thread message at `level`; discards it if that level
+// is off
+std::ostream& logAt(LogLevel level);
+
+// Records a trace event on the calling thread. `format` must be a string
+// literal; each "{}" in it is replaced by a then b when it is printed.
+inline void trace(const char* format, std::uint64_t a = 0, std::uint64_t b = 0) {
+    if (logEnabled(LogLevel::Trace)) log_detail::record(format, a, b);
+}
+
+// Prints the recorded trace events of all threads to `out`, oldest first,
+// and empties the buffers. Call only while no thread is recording.
+void flushTrace(std::ostream& out);
@@ -1,269 +1,250 @@
-//Implementing parallel merge-sort (divide and conquer) used in the Sorting stage to order the final word-count list from high to low, the output is saved in output2.txt
+//Implementing a parallel radix sort (independent buckets) used in the Sorting stage to order the final word-count list from A to Z, the output is saved in output.txt, and its ranking from high to low is saved in output2.txt
 //This is the code that we performed our 2nd and final testing on
 
 // src/main.cpp
 
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <thread>
-#include <unordered_map>
-#include <mutex>
-#include <functional>  // for std::hash
-#include <algorithm>   // for std::min, std::sort
-#include <cctype>      // for std::isalpha, std::tolower
+#include <cstdint>     // for std::uint64_t
+#include <algorithm>   // for std::min, std::find
 #include <chrono>      // for timing
-//#include <locale>      // for Unicode locale support delete
-#include <iterator>    
-
-
-static std::mutex ioMutex;  
-
-//Multi-threaded merge sort implementation
-template<typename It, typename Cmp>
-void parallelMergeSort(It first, It last, Cmp comp, unsigned depth = 0) {
-    auto n = std::distance(first, last);
-    if (n < 10000 || depth > std::thread::hardware_concurrency()) {
-        std::sort(first, last, comp);
-        return;
-    }
-    It mid = first + n/2;
-    std::thread t(parallelMergeSort<It,Cmp>, first, mid, comp, depth+1);
-    parallelMergeSort(mid, last, comp, depth+1);
-    t.join();
-    std::inplace_merge(first, mid, last, comp);
-}
+#include <cstdlib>     // for std::getenv
+#include <memory>      // for std::unique_ptr
+#include <atomic>
+
+#include "async_reader.hpp"
+#include "batch_reader.hpp"
+#include "input_files.hpp"
+#include "log.hpp"
+#include "metrics.hpp"
+#include "options.hpp"
+#include "output_writer.hpp"
+#include "result_file.hpp"
+#include "thread_pool.hpp"
+#include "tokenizer.hpp"
+#include "word_counter.hpp"
+
+namespace {
 
 // ————————————————————————————————————————————————————————
-// 1. Map phase: count words in [startLine, endLine)
-//    now skips digits, keeps Finnish letters and hyphens
+// Read & process the input in batches of about `batchBytes` bytes
+//    the inputs are read one after another as a single stream.
+//    large files are memory-mapped and a batch is just a
+//    string_view into the mapping; small files (and pipes) are
+//    copied into shared buffers, many files per batch, so both
+//    kinds are split across all threads by bytes.
+//    every cut is moved forward to the next separator byte.
+//    the three stages are pipelined: the reader thread fills
+//    batch N+1 while the pool maps batch N and merges batch N-1
 // ————————————————————————————————————————————————————————
-void countWordsInChunk(
-    const std::vector<std::string>& allLines,
-    std::size_t startLine,
-    std::size_t endLine,
-    std::unordered_map<std::string, std::size_t>& localCounts)
-{
-    {
-    std::lock_guard<std::mutex> lg(ioMutex);
-    auto tid = std::this_thread::get_id();
-    std::cout << "[Map] thread " << tid
-          << " handling lines " << startLine
-          << "–" << endLine << "\n";
+bool countInputs(WordCounter& counter, const std::vector<std::string>& inputFiles,
+                 const std::vector<std::string>& basePaths, std::size_t batchBytes,
+                 const ReaderOptions& readerOptions, std::string& error) {
+    const std::size_t READ_AHEAD  = 1;  // batches queued ahead of the map phase
+    RunMetrics& metrics = counter.metrics();
+    std::unique_ptr<BatchReader> reader;
+    if (!inputFiles.empty())
+        reader = std::make_unique<BatchReader>(inputFiles, batchBytes, READ_AHEAD,
+                                               counter.pool(), readerOptions);
+
+    // earlier results (checkpoints, or the inputs of `merge`) go through
+    // the same sharded reduce, one file at a time, while the reader thread
+    // is already loading the first batch
+    for (auto const& path : basePaths) {
+        ResultFile base;
+        if (!base.open(path, error) || !counter.addResults(base, error)) return false;
     }
-    for (std::size_t i = startLine; i < endLine; ++i) {
-        const std::string& line = allLines[i];
-        std::string word;
-        for (char ch : line) {
-            unsigned char uch = static_cast<unsigned char>(ch);
-            if ((std::isalpha(uch) || uch >= 0x80)  // only letters (ASCII or Finnish)
-                && ch != '-'                        // no hyphens
-               // && uch != 0xA0                       // no NBSP     //delete
-                && !std::isspace(uch)               // no spaces
-            ) {
-                word += ch;
-            }
-            else if (!word.empty()) {
-                localCounts[word]++;
-                word.clear();
-            }
-        }
-        if (!word.empty()) {
-            localCounts[word]++;
-        }
+
+    // streaming batches: the counter keeps each batch until it is merged,
+    // which happens while the next one is mapped, and then hands it back
+    Batch batch, released;
+    auto waitStart = MetricsClock::now();
+    while (reader && reader->next(batch)) {
+        metrics.readWait += since(waitStart);
+        if (!counter.feedBatch(std::move(batch), released, error)) return false;
+        reader->recycle(std::move(released));
+        waitStart = MetricsClock::now();
+    }
+    if (!reader) return true;
+    metrics.readWait += since(waitStart);
+    if (reader->failed()) {
+        error = "could not read " + reader->failure();
+        return false;
     }
+    metrics.addWork(Work::Read, reader->busyTime());
+    return true;
 }
 
+}  // namespace
+
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: wordcount <input_filename>\n";
-        return 1;
+    Options options;
+    std::string optionError;
+    if (!parseOptions(argc, argv, options, optionError)) {
+        if (!optionError.empty())
+            std::cerr << "Error: " << optionError << "\n";
+        printUsage(optionError.empty() ? std::cout : std::cerr);
+        return optionError.empty() ? 0 : 1;
     }
 
-    // enable Unicode-aware classification (e.g. NBSP as space)
-    //std::locale::global(std::locale(""));                       //delete
-
     // decide number of threads for map + merge
-    unsigned int threadCount = std::thread::hardware_concurrency();
-    //unsigned int threadCount = 4;
-
-    std::cout << "Number of cores/threads " << threadCount << "\n";
-
-    if (threadCount == 0) threadCount = 1;
-
-    // start total timer
-    auto totalStart = std::chrono::high_resolution_clock::now();
-    // start map timer
-    auto mapStart = std::chrono::high_resolution_clock::now();
-
-    // ————————————————————————————————————————————————————————
-    // Read & process file in batches of BATCH_SIZE lines
-    // ————————————————————————————————————————————————————————
-    const size_t BATCH_SIZE = 2000000;  // lines per batch
-    std::ifstream inputFile(argv[1]);
-    if (!inputFile) {
-        std::cerr << "Error opening file: " << argv[1] << "\n";
+    unsigned int threadCount = options.threads != 0 ? options.threads
+                                                    : std::thread::hardware_concurrency();
+    setWordHashSeed(options.hashSeed);  // before any table is filled
+    if (!options.kernel.empty() && !selectTokenizerKernel(options.kernel)) {
+        std::cerr << "Error: tokenizer kernel " << options.kernel
+                  << " is not available on this CPU\n";
         return 1;
     }
 
-    // prepare per-thread local maps and reserve
-    std::vector<std::unordered_map<std::string, std::size_t>> perThreadCounts(threadCount);
-    for (auto& m : perThreadCounts)
-        m.reserve(BATCH_SIZE / 10);
-
-    // prepare globalCounts + merge infrastructure
-    std::unordered_map<std::string, std::size_t> globalCounts;
-    globalCounts.reserve(4'000'000);  // estimate unique words
-    unsigned int stripeCount = threadCount;
-    std::vector<std::mutex> stripeLocks(stripeCount);
+    if (!options.stopwordsPath.empty()
+        && !readStopwords(options.stopwordsPath, options.tokenizer.stopwords, optionError)) {
+        std::cerr << "Error: " << optionError << "\n";
+        return 1;
+    }
 
-    // merge worker for parallel merge into globalCounts
-    auto mergeWorker = [&](unsigned int workerId) {
-        {
-        std::lock_guard<std::mutex> lg(ioMutex);
-        auto tid = std::this_thread::get_id();
-        std::cout << "[Merge] worker " << workerId
-                  << " (thread " << tid << ") starting\n";
+    setLogLevel(options.logLevel);
+    logAt(LogLevel::Info) << "Number of cores/threads " << threadCount << "\n";
+    logAt(LogLevel::Info) << "Tokenizer kernel " << activeTokenizerKernel().name << "\n";
+
+    std::vector<std::string> inputFiles;
+    if (!options.merge) {
+        // merge only: all counts come from the result files
+        std::string inputError;
+        if (!expandInputs(options.inputs, inputFiles, inputError)) {
+            std::cerr << "Error: " << inputError << "\n";
+            return 1;
         }
-        for (unsigned int i = 0; i < perThreadCounts.size(); ++i) {
-            if (i % threadCount != workerId) continue;
-            for (auto const& kv : perThreadCounts[i]) {
-                std::size_t h = std::hash<std::string>{}(kv.first);
-                unsigned int idx = h % stripeCount;
-                std::lock_guard<std::mutex> guard(stripeLocks[idx]);
-                globalCounts[kv.first] += kv.second;
-            }
-        }
-    };
-
-    std::vector<std::string> batch;
-    batch.reserve(BATCH_SIZE);
-    std::string line;
-    std::vector<std::thread> mapWorkers;
+        logAt(LogLevel::Info) << "Input files " << inputFiles.size() << "\n";
+    }
+    if (options.ngram > 1 && std::find(inputFiles.begin(), inputFiles.end(), "-") != inputFiles.end()) {
+        std::cerr << "Error: --ngram reads the input twice, so it can't read standard input\n";
+        return 1;
+    }
 
-    // streaming batches
-    while (std::getline(inputFile, line)) {
-        batch.push_back(std::move(line));
-        if (batch.size() == BATCH_SIZE) {
-            // Map phase on this batch
-            std::size_t totalLines = batch.size();
-            std::size_t linesPerThread = (totalLines + threadCount - 1) / threadCount;
+    // ————————————————————————————————————————————————————————
+    // The counting engine (word_counter.hpp): one pool for the whole run,
+    // with the main thread as the last worker, the per-thread tables and
+    // the sharded global table
+    // ————————————————————————————————————————————————————————
+    const std::size_t BATCH_BYTES = options.batchBytes != 0 ? options.batchBytes
+                                                            : std::size_t(256) << 20;  // bytes per batch
+    WordCounterOptions counterOptions;
+    counterOptions.tokenizer = options.tokenizer;
+    counterOptions.threads = options.threads;
+    counterOptions.pinning = options.pinning;
+    counterOptions.batchBytes = BATCH_BYTES;
+    counterOptions.memoryLimit = options.memoryLimit;
+    counterOptions.spillDir = options.spillDir;
+    counterOptions.hotWordCache = options.hotWordCache;
+    counterOptions.approx = options.approx;
+    // splitting tokenize and count time costs a little, so only on request
+    counterOptions.detailedTiming = options.metrics != MetricsFormat::None;
+    ReaderOptions readerOptions;
+    readerOptions.asyncReads = options.asyncReads;
+    readerOptions.directIo = options.directIo;
+    if (options.asyncReads)
+        logAt(LogLevel::Info) << "Input reads "
+                              << (ioUringAvailable() ? "io_uring" : "pread (no io_uring here)")
+                              << (options.directIo ? ", O_DIRECT" : "") << "\n";
+    std::string error;
 
-            for (auto& m : perThreadCounts) {
-                m.clear();
-                m.reserve(linesPerThread / 10);
-            }
-            mapWorkers.clear();
-            for (unsigned int t = 0; t < threadCount; ++t) {
-                std::size_t start = t * linesPerThread;
-                std::size_t end   = std::min(start + linesPerThread, totalLines);
-                if (start >= end) break;
-                mapWorkers.emplace_back(
-                    countWordsInChunk,
-                    std::cref(batch),
-                    start, end,
-                    std::ref(perThreadCounts[t])
-                );
-            }
-            for (auto& w : mapWorkers) w.join();
-            batch.clear();
+    // start total timer
+    auto totalStart = std::chrono::high_resolution_clock::now();
 
-            // Parallel Merge phase for this batch
-            std::vector<std::thread> mergeWorkers;
-            for (unsigned int w = 0; w < threadCount; ++w)
-                mergeWorkers.emplace_back(mergeWorker, w);
-            for (auto& w : mergeWorkers) w.join();
+    // n-grams: a first pass counts the words, whose A → Z list numbers
+    // them; its counter (pool and tables) is gone before the second starts
+    WordCounts dictionary;
+    std::chrono::nanoseconds dictionaryTime{0};
+    if (options.ngram > 1) {
+        auto dictionaryStart = MetricsClock::now();
+        WordCounter words(counterOptions);
+        if (!countInputs(words, inputFiles, {}, BATCH_BYTES, readerOptions, error)
+            || !words.finish(error)
+            || !words.snapshot(dictionary, error)) {
+            std::cerr << "Error: " << error << "\n";
+            return 1;
         }
+        dictionaryTime = since(dictionaryStart);
+        logAt(LogLevel::Info) << "[Dictionary] " << dictionary.size() << " words\n";
+        counterOptions.ngram = options.ngram;
+        counterOptions.dictionary = &dictionary;
     }
 
-    // leftover batch
-    if (!batch.empty()) {
-        std::size_t totalLines = batch.size();
-        std::size_t linesPerThread = (totalLines + threadCount - 1) / threadCount;
-        for (auto& m : perThreadCounts) {
-            m.clear();
-            m.reserve(linesPerThread / 10);
-        }
-        mapWorkers.clear();
-        for (unsigned int t = 0; t < threadCount; ++t) {
-            std::size_t start = t * linesPerThread;
-            std::size_t end   = std::min(start + linesPerThread, totalLines);
-            if (start >= end) break;
-            mapWorkers.emplace_back(
-                countWordsInChunk,
-                std::cref(batch),
-                start, end,
-                std::ref(perThreadCounts[t])
-            );
-        }
-        for (auto& w : mapWorkers) w.join();
+    WordCounter counter(counterOptions);
+    if (options.pinning != ThreadPinning::None)
+        logAt(LogLevel::Info) << "Threads pinned across " << counter.pool().nodeCount()
+                              << " NUMA node(s)\n";
+    ThreadPool& pool = counter.pool();
+    RunMetrics& metrics = counter.metrics();
+    metrics.at(Stage::Dictionary) = dictionaryTime;
 
-        std::vector<std::thread> mergeWorkers;
-        for (unsigned int w = 0; w < threadCount; ++w)
-            mergeWorkers.emplace_back(mergeWorker, w);
-        for (auto& w : mergeWorkers) w.join();
+    // start map timer
+    auto mapStart = std::chrono::high_resolution_clock::now();
+    if (!countInputs(counter, inputFiles, options.basePaths, BATCH_BYTES, readerOptions, error)) {
+        std::cerr << "Error: " << error << "\n";
+        return 1;
     }
-
-    inputFile.close();
-    // end map timer
+    // end map timer; finish() adds the wait for the last merge
     auto mapEnd = std::chrono::high_resolution_clock::now();
+    metrics.at(Stage::Count) += std::chrono::duration_cast<std::chrono::nanoseconds>(mapEnd - mapStart);
 
     // ————————————————————————————————————————————————————————
     // 6. Sort alphabetically and write final output
     // ————————————————————————————————————————————————————————
-    std::vector<std::pair<std::string, std::size_t>> sortedWords;
-    sortedWords.reserve(globalCounts.size());
-    for (auto const& kv : globalCounts)
-        sortedWords.emplace_back(kv.first, kv.second);
-    // std::sort(sortedWords.begin(), sortedWords.end(),
-    //     [](auto const& a, auto const& b){ return a.first < b.first; });
-    parallelMergeSort(
-        sortedWords.begin(), sortedWords.end(),
-        [](auto const& a, auto const& b){ return a.first < b.first; }
-    );
-
-    std::ofstream outputFile("output.txt");
-    if (!outputFile) {
-        std::cerr << "Error: could not open output.txt for writing\n";
+    if (!counter.finish(error)) {
+        std::cerr << "Error: " << error << "\n";
         return 1;
     }
-    outputFile << "=== Final Word Counts (A → Z) ===\n";
-    for (auto const& p : sortedWords)
-        outputFile << p.first << " -> " << p.second << "\n";
-    outputFile.close();
+    const WordCounts& sortedWords = counter.results();
+    if (options.approx.enabled)
+        logAt(LogLevel::Info) << "[Approx] " << sortedWords.size() << " heavy hitters of "
+                              << counter.wordsCounted() << " words; counts are at most "
+                              << counter.errorBound() << " high with probability "
+                              << 1 - options.approx.delta << "\n";
+
+    // spilled counts are streamed from the runs into both files, range by
+    // range, and never held in memory whole
+    const char* alphaHeader = "=== Final Word Counts (A → Z) ===\n";
+    auto writeStart = MetricsClock::now();
+    bool written = counter.spilled()
+        ? writeCountList(pool, "output.txt", alphaHeader, counter.spilledResults(), error)
+              && (options.binaryPath.empty()
+                  || writeResultFile(pool, options.binaryPath, counter.spilledResults(), error))
+        : writeCountList(pool, "output.txt", alphaHeader, sortedWords.entries(), nullptr, error)
+              && (options.binaryPath.empty()
+                  || writeResultFile(options.binaryPath, sortedWords.entries(), error));
+    if (!written) {
+        std::cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    metrics.at(Stage::Write) += since(writeStart);
 
 
     // ————————————————————————————————————————————————————————
 // Write counts sorted by descending frequency
 // ————————————————————————————————————————————————————————
-std::ofstream output2("output2.txt");
-if (!output2) {
-    std::cerr << "Error: could not open output2.txt for writing\n";
+// rank positions in sortedWords by count (high→low) instead of copying and
+// re-sorting the words; equal counts keep their A → Z order. spilled
+// counts only have their top K picked from the runs (--memory-limit
+// needs --top), which are then ranked the same way
+auto rankStart = MetricsClock::now();
+WordCounts top;
+if (counter.spilled()) counter.mostFrequent(options.topK, top);
+const WordCounts& ranked = counter.spilled() ? top : sortedWords;
+std::vector<std::size_t> freqOrder = counter.rankByFrequency(ranked, options.topK);
+metrics.at(Stage::SortFreq) = since(rankStart);
+writeStart = MetricsClock::now();
+
+if (!writeCountList(pool, "output2.txt", "=== Final Word Counts (High → Low) ===\n",
+                    ranked.entries(), &freqOrder, error)) {
+    std::cerr << "Error: " << error << "\n";
     return 1;
 }
-
-// copy sortedWords and sort by count (high→low)
-auto freqSorted = sortedWords;
-// std::sort(
-//     freqSorted.begin(),
-//     freqSorted.end(),
-//     [](auto const& a, auto const& b){
-//         return a.second > b.second;
-//     }
-// );
-parallelMergeSort(
-    freqSorted.begin(), freqSorted.end(),
-    [](auto const& a, auto const& b){ return a.second > b.second; }
-);
-
-
-
-output2 << "=== Final Word Counts (High → Low) ===\n";
-for (auto const& p : freqSorted) {
-    output2 << p.first << " -> " << p.second << "\n";
-}
-output2.close();
+metrics.at(Stage::Write) += since(writeStart);
 
 
     // ————————————————————————————————————————————————————————
@@ -273,9 +254,17 @@ output2.close();
     auto mapUs = std::chrono::duration_cast<std::chrono::microseconds>(mapEnd - mapStart).count();
     auto totUs = std::chrono::duration_cast<std::chrono::microseconds>(totalEnd - totalStart).count();
 
-    std::cout << "\n--- Timing (µs) ---\n"
-              << "Map:   " << mapUs   << "\n"
-              << "Total: " << totUs   << "\n";
+    // workers only recorded their trace events; print them now
+    flushTrace(std::cerr);
+
+    logAt(LogLevel::Info) << "\n--- Timing (µs) ---\n"
+                          << "Map:   " << mapUs   << "\n"
+                          << "Total: " << totUs   << "\n";
+
+    metrics.at(Stage::Total) = std::chrono::duration_cast<std::chrono::nanoseconds>(totalEnd - totalStart);
+    metrics.peakRssBytes = peakResidentBytes();
+    metrics.pool = pool.usage();
+    writeMetrics(std::cout, metrics, options.metrics);
 
     return 0;
 }
@@ -0,0 +1,82 @@
+// src/mapped_file.cpp
+
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      mapped_(std::exchange(other.mapped_, false)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        data_   = std::exchange(other.data_, nullptr);
+        size_   = std::exchange(other.size_, 0);
+        mapped_ = std::exchange(other.mapped_, false);
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    // mmap rejects zero-length mappings; an empty file is simply empty input
+    if (st.st_size == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    // a larger readahead window for the file, which is read once in order
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    void* p = ::mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                     PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+
+    // we scan front to back exactly once
+    ::madvise(p, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+
+    data_   = static_cast<const char*>(p);
+    size_   = static_cast<std::size_t>(st.st_size);
+    mapped_ = true;
+    return true;
+}
+
+void MappedFile::willNeed(std::size_t offset, std::size_t length) const {
+    if (!mapped_ || offset >= size_) return;
+    // madvise wants a page-aligned start
+    const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    std::size_t start = offset / page * page;
+    length = std::min(length, size_ - offset) + (offset - start);
+    ::madvise(const_cast<char*>(data_) + start, length, MADV_WILLNEED);
+}
+
+void MappedFile::close() {
+    if (mapped_)
+        ::munmap(const_cast<char*>(data_), size_);
+    data_   = nullptr;
+    size_   = 0;
+    mapped_ = false;
+}
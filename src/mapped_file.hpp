@@ -0,0 +1,41 @@
+// src/mapped_file.hpp
+//
+// Read-only memory mapping of an input file. The whole file is mapped once
+// and the map workers get std::string_view slices of it, so reading the
+// input costs no per-line allocations or copies.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Maps `path` read-only. Returns false (and leaves the object empty) if
+    // the file can't be opened or isn't a regular file that mmap accepts,
+    // e.g. a pipe; callers then fall back to stream reading.
+    bool open(const std::string& path);
+    void close();
+
+    const char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    std::string_view view() const { return {data_, size_}; }
+
+    // asks the kernel to start reading [offset, offset + length) of the
+    // file now, in the background, so touching it later finds it cached
+    void willNeed(std::size_t offset, std::size_t length) const;
+
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool mapped_ = false;
+};
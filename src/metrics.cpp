@@ -0,0 +1,126 @@
+// src/metrics.cpp
+
+#include "metrics.hpp"
+
+#include <sys/resource.h>
+
+#include <cstdio>
+#include <string>
+
+namespace {
+
+const char* const kStageNames[kStageCount] = {
+    "dictionary", "count", "spill", "sort_alpha", "sort_freq", "write", "total",
+};
+const char* const kWorkNames[kWorkCount] = {
+    "read", "tokenize", "local_count", "shuffle", "reduce",
+};
+
+std::int64_t micros(std::chrono::nanoseconds d) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+// fixed-point text without touching the stream's formatting state
+std::string fixed(double v, int decimals) {
+    char buf[64];
+    std::snprintf(buf, sizeof buf, "%.*f", decimals, v);
+    return buf;
+}
+
+std::string millis(std::chrono::nanoseconds d) { return fixed(d.count() / 1e6, 1); }
+
+void pad(std::ostream& out, const std::string& text, std::size_t width) {
+    out << text;
+    for (std::size_t n = text.size(); n < width; ++n) out << ' ';
+}
+
+// per second of the whole run
+double rate(std::uint64_t amount, const RunMetrics& m) {
+    double seconds = m.stage[static_cast<std::size_t>(Stage::Total)].count() / 1e9;
+    return seconds > 0 ? amount / seconds : 0.0;
+}
+
+// time the pool worker was not running a task
+std::chrono::nanoseconds idleOf(const ThreadUsage& u, const RunMetrics& m) {
+    auto total = m.stage[static_cast<std::size_t>(Stage::Total)];
+    return u.busy < total ? total - u.busy : std::chrono::nanoseconds(0);
+}
+
+void writeText(std::ostream& out, const RunMetrics& m) {
+    out << "\n--- Metrics ---\n"
+        << "Threads      " << m.threads << "\n"
+        << "Input        " << m.inputBytes << " bytes, " << m.words << " words, "
+        << m.uniqueWords << " unique\n"
+        << "Throughput   " << fixed(rate(m.inputBytes, m) / 1e6, 1) << " MB/s, "
+        << fixed(rate(m.words, m) / 1e6, 2) << " M words/s\n"
+        << "Peak RSS     " << m.peakRssBytes / 1024 << " KiB\n"
+        << "Stages (wall ms)\n";
+    for (std::size_t s = 0; s < kStageCount; ++s) {
+        out << "  ";
+        pad(out, kStageNames[s], 14);
+        out << millis(m.stage[s]);
+        if (s == static_cast<std::size_t>(Stage::Count))
+            out << "  (waiting for input " << millis(m.readWait) << ")";
+        out << "\n";
+    }
+    out << "Work (thread ms)\n";
+    for (std::size_t w = 0; w < kWorkCount; ++w) {
+        out << "  ";
+        pad(out, kWorkNames[w], 14);
+        out << millis(std::chrono::nanoseconds(m.workNs[w].load())) << "\n";
+    }
+    out << "Pool threads (busy / idle ms, tasks, stolen)\n";
+    for (std::size_t t = 0; t < m.pool.size(); ++t) {
+        bool caller = t + 1 == m.pool.size();
+        out << "  ";
+        pad(out, caller ? std::string("callers") : "worker " + std::to_string(t), 14);
+        out << millis(m.pool[t].busy) << " / "
+            << (caller ? std::string("-") : millis(idleOf(m.pool[t], m)))
+            << ", " << m.pool[t].tasks << ", " << m.pool[t].stolen << "\n";
+    }
+}
+
+void writeJson(std::ostream& out, const RunMetrics& m) {
+    out << "{\"threads\":" << m.threads
+        << ",\"input_bytes\":" << m.inputBytes
+        << ",\"words\":" << m.words
+        << ",\"unique_words\":" << m.uniqueWords
+        << ",\"bytes_per_s\":" << fixed(rate(m.inputBytes, m), 0)
+        << ",\"words_per_s\":" << fixed(rate(m.words, m), 0)
+        << ",\"peak_rss_bytes\":" << m.peakRssBytes
+        << ",\"stage_us\":{";
+    for (std::size_t s = 0; s < kStageCount; ++s)
+        out << (s ? "," : "") << '"' << kStageNames[s] << "\":" << micros(m.stage[s]);
+    out << "},\"read_wait_us\":" << micros(m.readWait) << ",\"work_us\":{";
+    for (std::size_t w = 0; w < kWorkCount; ++w)
+        out << (w ? "," : "") << '"' << kWorkNames[w]
+            << "\":" << micros(std::chrono::nanoseconds(m.workNs[w].load()));
+    out << "},\"pool\":[";
+    for (std::size_t t = 0; t < m.pool.size(); ++t) {
+        bool caller = t + 1 == m.pool.size();
+        out << (t ? "," : "") << "{\"thread\":";
+        if (caller)
+            out << "\"callers\"";
+        else
+            out << t;
+        out << ",\"busy_us\":" << micros(m.pool[t].busy);
+        if (!caller) out << ",\"idle_us\":" << micros(idleOf(m.pool[t], m));
+        out << ",\"tasks\":" << m.pool[t].tasks << ",\"stolen\":" << m.pool[t].stolen << "}";
+    }
+    out << "]}\n";
+}
+
+}  // namespace
+
+std::uint64_t peakResidentBytes() {
+    struct rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;  // Linux reports KiB
+}
+
+void writeMetrics(std::ostream& out, const RunMetrics& m, MetricsFormat format) {
+    if (format == MetricsFormat::Json)
+        writeJson(out, m);
+    else if (format == MetricsFormat::Text)
+        writeText(out, m);
+}
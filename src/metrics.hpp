@@ -0,0 +1,74 @@
+// src/metrics.hpp
+//
+// Numbers behind --metrics. Two kinds of time are kept. Stages are the
+// steps of the run one after another as the main thread sees them (wall
+// time). Work is time summed over every thread that did that kind of work;
+// reading, counting and reducing overlap in the pipeline, so their work
+// times can add up to more than the count stage took.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+using MetricsClock = std::chrono::steady_clock;
+
+// --metrics: a breakdown of the run printed after it, as text or JSON
+enum class MetricsFormat { None, Text, Json };
+
+enum class Stage {
+    Dictionary, // --ngram: the first pass, counting the words
+    Count,      // read + map + reduce pipeline, base files included
+    Spill,      // writing spill runs and merging them back
+    SortAlpha,  // A -> Z order of the final list
+    SortFreq,   // ranking by count
+    Write,      // output.txt, output2.txt and the binary file
+    Total,
+};
+constexpr std::size_t kStageCount = 7;
+
+enum class Work {
+    Read,        // reader thread: read, decode, copy (not queue waits)
+    Tokenize,    // map tasks splitting text into words
+    LocalCount,  // map tasks adding words to their local tables
+    Shuffle,     // map tasks bucketing local counts by shard
+    Reduce,      // merge tasks adding buckets into the global shards
+};
+constexpr std::size_t kWorkCount = 5;
+
+struct RunMetrics {
+    unsigned int threads = 0;
+    std::uint64_t inputBytes = 0;
+    std::uint64_t words = 0;        // words counted, repeats included
+    std::uint64_t uniqueWords = 0;
+    std::uint64_t peakRssBytes = 0;
+    std::array<std::chrono::nanoseconds, kStageCount> stage{};
+    std::chrono::nanoseconds readWait{0};  // main thread waiting for a batch
+    std::array<std::atomic<std::int64_t>, kWorkCount> workNs{};
+    std::vector<ThreadUsage> pool;  // from ThreadPool::usage()
+
+    std::chrono::nanoseconds& at(Stage s) { return stage[static_cast<std::size_t>(s)]; }
+
+    // safe to call from any thread
+    void addWork(Work w, std::chrono::nanoseconds d) {
+        workNs[static_cast<std::size_t>(w)].fetch_add(d.count(), std::memory_order_relaxed);
+    }
+};
+
+// wall time since `start`
+inline std::chrono::nanoseconds since(MetricsClock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(MetricsClock::now() - start);
+}
+
+// high-water mark of this process's resident memory, 0 if unknown
+std::uint64_t peakResidentBytes();
+
+// Prints `m` as a table (Text) or as one JSON object (Json).
+void writeMetrics(std::ostream& out, const RunMetrics& m, MetricsFormat format);
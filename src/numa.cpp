@@ -0,0 +1,143 @@
+// src/numa.cpp
+
+#include "numa.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// the CPUs of a cpulist such as "0-3,8-11", in order
+std::vector<int> parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::size_t at = 0;
+    while (at < text.size()) {
+        std::size_t end = text.find(',', at);
+        if (end == std::string::npos) end = text.size();
+        std::string range = text.substr(at, end - at);
+        at = end + 1;
+        if (range.empty() || range[0] < '0' || range[0] > '9') continue;
+        std::size_t dash = range.find('-');
+        int first = std::atoi(range.c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// the CPUs the process may use, taken before main() pins any thread
+cpu_set_t startMask() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) CPU_SET(cpu, &set);
+    return set;
+}
+const cpu_set_t kStartMask = startMask();
+
+std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, &kStartMask)) cpus.push_back(cpu);
+    return cpus;
+}
+
+}  // namespace
+
+std::vector<NumaNode> numaTopology() {
+    std::vector<int> allowed = allowedCpus();
+    std::vector<NumaNode> nodes;
+    std::error_code ec;
+    for (fs::directory_iterator it("/sys/devices/system/node", ec), end; !ec && it != end;
+         it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        if (name.size() <= 4 || name.compare(0, 4, "node") != 0
+            || name.find_first_not_of("0123456789", 4) != std::string::npos)
+            continue;
+        std::ifstream list(it->path() / "cpulist");
+        std::string text;
+        if (!std::getline(list, text)) continue;
+        NumaNode node{static_cast<unsigned int>(std::atoi(name.c_str() + 4)), {}};
+        for (int cpu : parseCpuList(text))
+            if (std::binary_search(allowed.begin(), allowed.end(), cpu))
+                node.cpus.push_back(cpu);
+        if (!node.cpus.empty()) nodes.push_back(std::move(node));
+    }
+    if (nodes.empty()) nodes.push_back({0, allowed});
+    std::sort(nodes.begin(), nodes.end(),
+              [](NumaNode const& a, NumaNode const& b) { return a.id < b.id; });
+    return nodes;
+}
+
+ThreadPlacement placeThreads(unsigned int threads, ThreadPinning pinning) {
+    ThreadPlacement placement;
+    placement.cpu.assign(threads, -1);
+    placement.node.assign(threads, 0);
+    std::vector<NumaNode> nodes = numaTopology();
+    if (pinning == ThreadPinning::None || threads == 0 || nodes[0].cpus.empty())
+        return placement;
+
+    // topology index of every thread's node; more threads than CPUs wrap
+    std::vector<std::size_t> home(threads);
+    if (pinning == ThreadPinning::Compact) {
+        std::vector<std::pair<std::size_t, int>> order;
+        for (std::size_t n = 0; n < nodes.size(); ++n)
+            for (int cpu : nodes[n].cpus) order.emplace_back(n, cpu);
+        for (unsigned int i = 0; i < threads; ++i) {
+            home[i] = order[i % order.size()].first;
+            placement.cpu[i] = order[i % order.size()].second;
+        }
+    } else {
+        for (unsigned int i = 0; i < threads; ++i) {
+            const NumaNode& node = nodes[i % nodes.size()];
+            home[i] = i % nodes.size();
+            placement.cpu[i] = node.cpus[(i / nodes.size()) % node.cpus.size()];
+        }
+    }
+
+    // number the nodes that got a thread 0, 1, ... in topology order
+    std::vector<unsigned int> dense(nodes.size(), 0);
+    std::vector<bool> used(nodes.size(), false);
+    for (std::size_t n : home) used[n] = true;
+    placement.nodes = 0;
+    for (std::size_t n = 0; n < nodes.size(); ++n)
+        if (used[n]) dense[n] = placement.nodes++;
+    for (unsigned int i = 0; i < threads; ++i) placement.node[i] = dense[home[i]];
+    return placement;
+}
+
+bool pinCurrentThread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+std::vector<int> currentThreadCpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::vector<int> cpus;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0) return cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    return cpus;
+}
+
+bool setCurrentThreadCpus(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    return !cpus.empty() && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
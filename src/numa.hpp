@@ -0,0 +1,49 @@
+// src/numa.hpp
+//
+// Thread placement on NUMA hosts. On a multi-socket machine, memory is
+// attached to one node and reads from another node's memory cost about
+// twice as much. By default the scheduler moves threads freely, so a map
+// table's pages end up wherever its thread ran first. With pinning, every
+// pool thread stays on one CPU, so the run knows each thread's node and
+// where the memory that thread touches first is placed:
+//
+//   compact  fills the CPUs of node 0 first, then node 1, ... (fewest
+//            nodes, shared caches)
+//   scatter  deals threads to the nodes in turn (all memory controllers
+//            and L3s from the first threads on)
+//
+// The topology is read from sysfs, restricted to the CPUs the process may
+// run on; without NUMA information the host is one node of all those CPUs.
+
+#pragma once
+
+#include <vector>
+
+enum class ThreadPinning { None, Compact, Scatter };
+
+struct NumaNode {
+    unsigned int id;        // kernel node number
+    std::vector<int> cpus;  // CPUs of the node this process may use
+};
+
+// the nodes with at least one usable CPU, in id order; never empty
+std::vector<NumaNode> numaTopology();
+
+// Where each of a run's threads goes. Thread i runs on CPU cpu[i] (-1:
+// not pinned) of node node[i], an index in 0..nodes-1 over the nodes that
+// got a thread. Unpinned threads all count as node 0.
+struct ThreadPlacement {
+    unsigned int nodes = 1;
+    std::vector<int> cpu;
+    std::vector<unsigned int> node;
+};
+
+ThreadPlacement placeThreads(unsigned int threads, ThreadPinning pinning);
+
+// pins the calling thread to `cpu`; false if the kernel refused
+bool pinCurrentThread(int cpu);
+
+// the CPUs the calling thread may run on, to give back with
+// setCurrentThreadCpus() after pinning it; empty if they can't be read
+std::vector<int> currentThreadCpus();
+bool setCurrentThreadCpus(const std::vector<int>& cpus);
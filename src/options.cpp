@@ -0,0 +1,354 @@
+// src/options.cpp
+
+#include "options.hpp"
+
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string_view>
+
+namespace {
+
+// Matches "--name value" and "--name=value" at argv[i], advancing i past a
+// separate value. Returns true for a match; a missing value also sets
+// `error`.
+bool optionValue(int argc, char* argv[], int& i, std::string_view name,
+                 std::string_view& value, std::string& error) {
+    std::string_view arg = argv[i];
+    if (arg.substr(0, name.size()) != name) return false;
+    if (arg.size() == name.size()) {
+        if (i + 1 == argc) {
+            error = std::string(name) + " needs a value";
+            return true;
+        }
+        value = argv[++i];
+        return true;
+    }
+    if (arg[name.size()] != '=') return false;
+    value = arg.substr(name.size() + 1);
+    return true;
+}
+
+// "512M", "2G", "1048576": a byte count with an optional K/M/G suffix
+bool parseSize(std::string_view text, std::size_t& bytes) {
+    std::size_t shift = 0;
+    if (!text.empty()) {
+        switch (text.back() | 0x20) {
+        case 'k': shift = 10; break;
+        case 'm': shift = 20; break;
+        case 'g': shift = 30; break;
+        }
+        if (shift != 0) text.remove_suffix(1);
+    }
+    std::size_t n = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), n);
+    if (ec != std::errc() || end != text.data() + text.size() || n == 0
+        || n > (SIZE_MAX >> shift))
+        return false;
+    bytes = n << shift;
+    return true;
+}
+
+// a fraction strictly between 0 and 1, e.g. "0.001" or "1e-5"
+bool parseFraction(std::string_view text, double& value) {
+    // from_chars for doubles isn't in every C++17 library yet
+    std::string copy(text);
+    char* end = nullptr;
+    double v = std::strtod(copy.c_str(), &end);
+    if (copy.empty() || end != copy.c_str() + copy.size() || !(v > 0 && v < 1)) return false;
+    value = v;
+    return true;
+}
+
+}  // namespace
+
+void printUsage(std::ostream& out) {
+    out << "Usage: wordcount [options] <input>...\n"
+        << "       wordcount merge [options] <result_file>...\n"
+        << "An input is a file, a directory (every file below it) or a glob.\n"
+        << "Options:\n"
+        << "  --fold-case   count words case-insensitively (ASCII, Latin-1 and\n"
+        << "                Latin Extended-A letters are lowercased)\n"
+        << "  --ascii-only  words are runs of ASCII letters; any other byte\n"
+        << "                separates them\n"
+        << "  --min-length N, --max-length N\n"
+        << "                skip words of fewer / more than N letters\n"
+        << "  --stopwords FILE\n"
+        << "                skip the words listed in FILE (whitespace separated)\n"
+        << "  --ngram N     count runs of N adjacent words (\"a b c\") instead of\n"
+        << "                single words, in a second pass over the input;\n"
+        << "                skipped words don't break a run\n"
+        << "  --bigrams     same as --ngram 2\n"
+        << "  --approx      estimate the counts of the most frequent words in fixed\n"
+        << "                memory (Count-Min sketch and Space-Saving list) instead\n"
+        << "                of counting every word exactly\n"
+        << "  --approx-epsilon E, --approx-delta D\n"
+        << "                an estimate exceeds the true count by at most E times\n"
+        << "                all words, except with probability D (default 0.0001\n"
+        << "                and 0.01)\n"
+        << "  --approx-words K\n"
+        << "                heavy hitters to keep and write (default 1000)\n"
+        << "  --top K       write only the K most frequent words to output2.txt\n"
+        << "  --binary FILE also write the A -> Z counts to FILE in the binary,\n"
+        << "                memory-mappable result format\n"
+        << "  --base FILE   add the counts of result FILE (from --binary) to this\n"
+        << "                run; may be repeated\n"
+        << "  --memory-limit SIZE\n"
+        << "                keep the word table under SIZE bytes (K/M/G suffixes\n"
+        << "                allowed) by spilling sorted runs to disk; the\n"
+        << "                results are then streamed from the runs, and\n"
+        << "                output2.txt needs --top K\n"
+        << "  --spill-dir DIR\n"
+        << "                directory for spilled runs (default: $TMPDIR or /tmp)\n"
+        << "  --threads N   use N threads (default: one per hardware thread)\n"
+        << "  --pin none|compact|scatter\n"
+        << "                pin each thread to one CPU, filling one NUMA node\n"
+        << "                after the other (compact) or dealing threads to the\n"
+        << "                nodes in turn (scatter); default: not pinned\n"
+        << "  --batch-size SIZE\n"
+        << "                bytes of input per batch (default 256M)\n"
+        << "  --io mmap|uring\n"
+        << "                map large input files (default), or read them with\n"
+        << "                many large reads in flight through io_uring (pread\n"
+        << "                where that's unavailable), for input not in the cache\n"
+        << "  --direct-io   with --io uring: read with O_DIRECT, bypassing the\n"
+        << "                page cache\n"
+        << "  --kernel NAME tokenizer kernel: avx2, sse2, neon or scalar\n"
+        << "                (default: the best this CPU supports)\n"
+        << "  --no-hot-cache\n"
+        << "                count every word in the thread's table directly,\n"
+        << "                without the hot-word cache (for comparisons)\n"
+        << "  --hash-seed N seed the word hash with N, or with a random value for\n"
+        << "                \"random\" (against input crafted to collide; default 0)\n"
+        << "  --metrics[=json]\n"
+        << "                print per-phase timings, per-thread busy/idle time,\n"
+        << "                throughput and peak memory after the run\n"
+        << "  --log-level LEVEL\n"
+        << "                error (errors only), info (progress and timings,\n"
+        << "                the default) or trace (also what every thread did,\n"
+        << "                printed after the run)\n"
+        << "  -q, --quiet   same as --log-level error\n"
+        << "  -v, --verbose same as --log-level trace\n"
+        << "  -h, --help    show this help\n";
+}
+
+bool parseOptions(int argc, char* argv[], Options& options, std::string& error) {
+    std::string_view value;
+    bool approxTuned = false;  // an --approx-* value, which needs --approx
+    int first = 1;
+    if (argc > 1 && std::string_view(argv[1]) == "merge") {
+        options.merge = true;
+        first = 2;
+    }
+    for (int i = first; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            error.clear();
+            return false;
+        } else if (arg == "--fold-case") {
+            options.tokenizer.foldCase = true;
+        } else if (arg == "--ascii-only") {
+            options.tokenizer.asciiOnly = true;
+        } else if (arg == "--bigrams") {
+            options.ngram = 2;
+        } else if (arg == "--approx") {
+            options.approx.enabled = true;
+        } else if (optionValue(argc, argv, i, "--approx-epsilon", value, error)
+                   || optionValue(argc, argv, i, "--approx-delta", value, error)) {
+            if (!error.empty()) return false;
+            bool epsilon = arg.substr(0, 16) == "--approx-epsilon";
+            if (!parseFraction(value, epsilon ? options.approx.epsilon : options.approx.delta)) {
+                error = std::string(epsilon ? "invalid --approx-epsilon " : "invalid --approx-delta ")
+                      + std::string(value);
+                return false;
+            }
+            approxTuned = true;
+        } else if (optionValue(argc, argv, i, "--approx-words", value, error)) {
+            if (!error.empty()) return false;
+            std::size_t k = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), k);
+            if (ec != std::errc() || end != value.data() + value.size() || k == 0
+                || k >= UINT32_MAX / 2) {
+                error = "invalid --approx-words count " + std::string(value);
+                return false;
+            }
+            options.approx.heavyHitters = k;
+            approxTuned = true;
+        } else if (optionValue(argc, argv, i, "--ngram", value, error)) {
+            if (!error.empty()) return false;
+            unsigned int n = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), n);
+            if (ec != std::errc() || end != value.data() + value.size() || n == 0) {
+                error = "invalid --ngram length " + std::string(value);
+                return false;
+            }
+            options.ngram = n;
+        } else if (optionValue(argc, argv, i, "--min-length", value, error)
+                   || optionValue(argc, argv, i, "--max-length", value, error)) {
+            if (!error.empty()) return false;
+            bool min = arg.substr(0, 12) == "--min-length";
+            std::size_t n = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), n);
+            if (ec != std::errc() || end != value.data() + value.size() || n == 0) {
+                error = std::string(min ? "invalid --min-length " : "invalid --max-length ")
+                      + std::string(value);
+                return false;
+            }
+            (min ? options.tokenizer.minLength : options.tokenizer.maxLength) = n;
+        } else if (optionValue(argc, argv, i, "--stopwords", value, error)) {
+            if (!error.empty()) return false;
+            options.stopwordsPath = std::string(value);
+        } else if (optionValue(argc, argv, i, "--hash-seed", value, error)) {
+            if (!error.empty()) return false;
+            if (value == "random") {
+                std::random_device entropy;
+                options.hashSeed = (std::uint64_t(entropy()) << 32) ^ entropy();
+            } else {
+                auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(),
+                                                 options.hashSeed);
+                if (ec != std::errc() || end != value.data() + value.size()) {
+                    error = "invalid --hash-seed " + std::string(value);
+                    return false;
+                }
+            }
+        } else if (arg == "--no-hot-cache") {
+            options.hotWordCache = false;
+        } else if (arg == "-q" || arg == "--quiet") {
+            options.logLevel = LogLevel::Error;
+        } else if (arg == "-v" || arg == "--verbose") {
+            options.logLevel = LogLevel::Trace;
+        } else if (optionValue(argc, argv, i, "--log-level", value, error)) {
+            if (!error.empty()) return false;
+            if (value == "error") {
+                options.logLevel = LogLevel::Error;
+            } else if (value == "info") {
+                options.logLevel = LogLevel::Info;
+            } else if (value == "trace") {
+                options.logLevel = LogLevel::Trace;
+            } else {
+                error = "invalid --log-level " + std::string(value);
+                return false;
+            }
+        } else if (arg == "--metrics" || arg == "--metrics=text") {
+            // the format is optional, so it can only be given after '='
+            options.metrics = MetricsFormat::Text;
+        } else if (arg == "--metrics=json") {
+            options.metrics = MetricsFormat::Json;
+        } else if (arg.substr(0, 10) == "--metrics=") {
+            error = "invalid --metrics format " + std::string(arg.substr(10));
+            return false;
+        } else if (optionValue(argc, argv, i, "--top", value, error)) {
+            if (!error.empty()) return false;
+            std::size_t k = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), k);
+            if (ec != std::errc() || end != value.data() + value.size() || k == 0) {
+                error = "invalid --top count " + std::string(value);
+                return false;
+            }
+            options.topK = k;
+        } else if (optionValue(argc, argv, i, "--threads", value, error)) {
+            if (!error.empty()) return false;
+            unsigned int n = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), n);
+            if (ec != std::errc() || end != value.data() + value.size() || n == 0) {
+                error = "invalid --threads count " + std::string(value);
+                return false;
+            }
+            options.threads = n;
+        } else if (optionValue(argc, argv, i, "--pin", value, error)) {
+            if (!error.empty()) return false;
+            if (value == "none") {
+                options.pinning = ThreadPinning::None;
+            } else if (value == "compact") {
+                options.pinning = ThreadPinning::Compact;
+            } else if (value == "scatter") {
+                options.pinning = ThreadPinning::Scatter;
+            } else {
+                error = "invalid --pin placement " + std::string(value);
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--batch-size", value, error)) {
+            if (!error.empty()) return false;
+            if (!parseSize(value, options.batchBytes)) {
+                error = "invalid --batch-size " + std::string(value);
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--io", value, error)) {
+            if (!error.empty()) return false;
+            if (value == "mmap") {
+                options.asyncReads = false;
+            } else if (value == "uring") {
+                options.asyncReads = true;
+            } else {
+                error = "invalid --io reader " + std::string(value);
+                return false;
+            }
+        } else if (arg == "--direct-io") {
+            options.directIo = true;
+        } else if (optionValue(argc, argv, i, "--kernel", value, error)) {
+            if (!error.empty()) return false;
+            options.kernel = std::string(value);
+        } else if (optionValue(argc, argv, i, "--binary", value, error)) {
+            if (!error.empty()) return false;
+            options.binaryPath = std::string(value);
+        } else if (optionValue(argc, argv, i, "--memory-limit", value, error)) {
+            if (!error.empty()) return false;
+            if (!parseSize(value, options.memoryLimit)) {
+                error = "invalid --memory-limit " + std::string(value);
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--spill-dir", value, error)) {
+            if (!error.empty()) return false;
+            options.spillDir = std::string(value);
+        } else if (optionValue(argc, argv, i, "--base", value, error)) {
+            if (!error.empty()) return false;
+            options.basePaths.emplace_back(value);
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            error = "unknown option " + std::string(arg);
+            return false;
+        } else if (options.merge) {
+            options.basePaths.emplace_back(arg);
+        } else {
+            options.inputs.emplace_back(arg);
+        }
+    }
+    if (options.tokenizer.maxLength != 0
+        && options.tokenizer.minLength > options.tokenizer.maxLength) {
+        error = "--min-length is greater than --max-length";
+        return false;
+    }
+    if (options.ngram > 1 && (options.merge || !options.basePaths.empty())) {
+        error = "--ngram can't be combined with result files";
+        return false;
+    }
+    if (options.directIo && !options.asyncReads) {
+        error = "--direct-io needs --io uring";
+        return false;
+    }
+    if (approxTuned && !options.approx.enabled) {
+        error = "--approx-epsilon, --approx-delta and --approx-words need --approx";
+        return false;
+    }
+    if (options.approx.enabled
+        && (options.ngram > 1 || options.merge || !options.basePaths.empty()
+            || options.memoryLimit != 0)) {
+        error = "--approx can't be combined with --ngram, result files or --memory-limit";
+        return false;
+    }
+    if (options.memoryLimit != 0 && options.topK == 0) {
+        // spilled counts are streamed to output.txt, but a full ranking
+        // for output2.txt would hold every word in memory again
+        error = "--memory-limit needs --top K for output2.txt";
+        return false;
+    }
+    if (options.merge && options.basePaths.empty()) {
+        error = "merge needs at least one result file";
+        return false;
+    }
+    if (!options.merge && options.inputs.empty()) {
+        error = "missing input file";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+// src/options.hpp
+//
+// Command-line options of the wordcount tool.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "approx_counts.hpp"
+#include "log.hpp"
+#include "metrics.hpp"
+#include "numa.hpp"
+#include "tokenizer.hpp"
+
+struct Options {
+    // `wordcount merge`: combine result files (basePaths), count no text
+    bool merge = false;
+    std::vector<std::string> inputs;     // files, directories or globs to count
+    std::vector<std::string> basePaths;  // result files added to the counts
+    TokenizerOptions tokenizer;
+    std::string stopwordsPath;  // read into tokenizer.stopwords by main()
+    unsigned int ngram = 1;     // words per counted key; > 1 reads the input twice
+    ApproxOptions approx;       // --approx: estimated counts of the heavy hitters
+    std::size_t topK = 0;    // output2.txt: 0 ranks every word
+    std::string binaryPath;  // binary result file, if wanted
+    std::size_t memoryLimit = 0;  // bytes for the global table, 0 = no limit
+    std::string spillDir;         // where runs go past the limit; "" = temp dir
+    MetricsFormat metrics = MetricsFormat::None;
+    LogLevel logLevel = LogLevel::Info;
+    unsigned int threads = 0;     // 0 = one per hardware thread
+    ThreadPinning pinning = ThreadPinning::None;
+    std::size_t batchBytes = 0;   // 0 = the built-in batch size
+    bool asyncReads = false;      // --io uring: read large files, don't map them
+    bool directIo = false;        // --direct-io: and bypass the page cache
+    std::string kernel;           // tokenizer kernel; "" = best available
+    bool hotWordCache = true;     // hot-word cache in front of the map tables
+    std::uint64_t hashSeed = 0;   // seed of the word hash
+};
+
+// Parses argv into `options`. On failure returns false with a message in
+// `error`; an empty error means usage was requested (--help).
+bool parseOptions(int argc, char* argv[], Options& options, std::string& error);
+
+void printUsage(std::ostream& out);
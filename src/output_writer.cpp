@@ -0,0 +1,185 @@
+// src/output_writer.cpp
+
+#include "output_writer.hpp"
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// lines per formatting task, a few hundred KiB of output
+constexpr std::size_t kChunkLines = 16384;
+// bytes a range of a RangedCounts is formatted into before each write
+constexpr std::size_t kRangeBuffer = std::size_t(1) << 18;
+
+constexpr std::string_view kArrow = " -> ";
+
+std::size_t digitsOf(std::uint64_t v) {
+    std::size_t n = 1;
+    while (v >= 10) { v /= 10; ++n; }
+    return n;
+}
+
+std::size_t lineLength(std::string_view key, std::uint64_t count) {
+    return key.size() + kArrow.size() + digitsOf(count) + 1;
+}
+
+std::size_t lineLength(const CountEntry& e) { return lineLength(e.key, e.count); }
+
+char* formatLine(char* out, char* end, std::string_view key, std::uint64_t count) {
+    std::memcpy(out, key.data(), key.size());
+    out += key.size();
+    std::memcpy(out, kArrow.data(), kArrow.size());
+    out += kArrow.size();
+    out = std::to_chars(out, end, count).ptr;
+    *out++ = '\n';
+    return out;
+}
+
+// writes all of buf at offset; returns 0 or the errno of the failure
+int writeAt(int fd, const char* buf, std::size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, buf, size, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        buf += n;
+        size -= static_cast<std::size_t>(n);
+        offset += n;
+    }
+    return 0;
+}
+
+}  // namespace
+
+bool writeCountList(ThreadPool& pool, const std::string& path, std::string_view header,
+                    const std::vector<CountEntry>& entries,
+                    const std::vector<std::size_t>* order, std::string& error) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = "could not open " + path + " for writing";
+        return false;
+    }
+
+    std::size_t lines = order ? order->size() : entries.size();
+    auto entryAt = [&](std::size_t line) -> const CountEntry& {
+        return entries[order ? (*order)[line] : line];
+    };
+    std::size_t chunks = (lines + kChunkLines - 1) / kChunkLines;
+
+    // 1. byte size of every chunk, then each chunk's file offset
+    std::vector<std::size_t> offsets(chunks + 1, 0);
+    {
+        TaskGroup tasks(pool);
+        for (std::size_t c = 0; c < chunks; ++c) {
+            tasks.run([&, c] {
+                std::size_t bytes = 0;
+                std::size_t end = std::min(lines, (c + 1) * kChunkLines);
+                for (std::size_t line = c * kChunkLines; line < end; ++line)
+                    bytes += lineLength(entryAt(line));
+                offsets[c + 1] = bytes;
+            });
+        }
+        tasks.wait();
+    }
+    offsets[0] = header.size();
+    for (std::size_t c = 0; c < chunks; ++c) offsets[c + 1] += offsets[c];
+
+    // 2. every chunk formats into its own buffer and writes it in place
+    std::atomic<int> failure{writeAt(fd, header.data(), header.size(), 0)};
+    {
+        TaskGroup tasks(pool);
+        for (std::size_t c = 0; c < chunks && failure.load() == 0; ++c) {
+            tasks.run([&, c] {
+                std::vector<char> buf(offsets[c + 1] - offsets[c]);
+                char* out = buf.data();
+                std::size_t end = std::min(lines, (c + 1) * kChunkLines);
+                for (std::size_t line = c * kChunkLines; line < end; ++line) {
+                    const CountEntry& e = entryAt(line);
+                    out = formatLine(out, buf.data() + buf.size(), e.key, e.count);
+                }
+                int err = writeAt(fd, buf.data(), buf.size(), static_cast<off_t>(offsets[c]));
+                if (err != 0) {
+                    int none = 0;
+                    failure.compare_exchange_strong(none, err);
+                }
+            });
+        }
+        tasks.wait();
+    }
+
+    int err = failure.load();
+    if (::close(fd) != 0 && err == 0) err = errno;
+    if (err != 0) {
+        error = "could not write " + path + ": " + std::strerror(err);
+        return false;
+    }
+    return true;
+}
+
+bool writeCountList(ThreadPool& pool, const std::string& path, std::string_view header,
+                    const RangedCounts& counts, std::string& error) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = "could not open " + path + " for writing";
+        return false;
+    }
+
+    // the ranges are sized up front, so their offsets are known
+    std::size_t ranges = counts.rangeCount();
+    std::vector<std::uint64_t> offsets(ranges + 1, header.size());
+    for (std::size_t r = 0; r < ranges; ++r) {
+        const CountRange& range = counts.range(r);
+        offsets[r + 1] = offsets[r] + range.keyBytes
+                         + range.words * (kArrow.size() + 1) + range.countDigits;
+    }
+
+    std::atomic<int> failure{writeAt(fd, header.data(), header.size(), 0)};
+    auto report = [&](int err) {
+        int none = 0;
+        if (err != 0) failure.compare_exchange_strong(none, err);
+    };
+    {
+        TaskGroup tasks(pool);
+        for (std::size_t r = 0; r < ranges && failure.load() == 0; ++r) {
+            tasks.run([&, r] {
+                std::vector<char> buf(kRangeBuffer);
+                std::size_t used = 0;
+                std::uint64_t at = offsets[r];
+                auto flush = [&] {
+                    report(writeAt(fd, buf.data(), used, static_cast<off_t>(at)));
+                    at += used;
+                    used = 0;
+                };
+                counts.forEach(r, [&](std::string_view word, std::uint64_t count) {
+                    std::size_t length = lineLength(word, count);
+                    if (used + length > buf.size()) {
+                        flush();
+                        if (length > buf.size()) buf.resize(length);
+                    }
+                    formatLine(buf.data() + used, buf.data() + buf.size(), word, count);
+                    used += length;
+                });
+                flush();
+            });
+        }
+        tasks.wait();
+    }
+
+    int err = failure.load();
+    if (::close(fd) != 0 && err == 0) err = errno;
+    if (err != 0) {
+        error = "could not write " + path + ": " + std::strerror(err);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+// src/output_writer.hpp
+//
+// Bulk writer for the "word -> count" result files. The exact size of every
+// line is known up front, so the list is cut into chunks whose file offsets
+// are computed before anything is formatted; each chunk is then formatted
+// by a pool task into its own buffer with std::to_chars and written with
+// one pwrite at its offset. No stream, locale or per-line call is involved,
+// and the chunks need no ordering between them.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ranged_counts.hpp"
+#include "sharded_counts.hpp"
+#include "thread_pool.hpp"
+
+// Writes `header` followed by one line per entry to `path`, replacing the
+// file. Lines follow `order` (positions into `entries`) when it is given,
+// and the order of `entries` otherwise. On failure returns false with a
+// message in `error`.
+bool writeCountList(ThreadPool& pool, const std::string& path, std::string_view header,
+                    const std::vector<CountEntry>& entries,
+                    const std::vector<std::size_t>* order, std::string& error);
+
+// The same for a list read range by range (spilled counts): each range is
+// a pool task that formats into a small buffer and writes it at its place.
+bool writeCountList(ThreadPool& pool, const std::string& path, std::string_view header,
+                    const RangedCounts& counts, std::string& error);
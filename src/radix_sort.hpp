@@ -0,0 +1,269 @@
+// src/radix_sort.hpp
+//
+// Parallel MSD radix sort for the alphabetical output. Elements are ordered
+// by the bytes of keyOf(element) (a string_view), compared as unsigned
+// chars with a key that ends sorting first: the same order as
+// std::string's operator<. Every pass buckets a range by the byte at the
+// current depth; the buckets are independent and become separate tasks,
+// so the parallelism comes from the data rather than from a fixed split.
+//
+// The elements themselves don't move while sorting. Each is represented by
+// 8 bytes: its index and, above it, the buckets of its first three key
+// bytes. The top three levels, which see every element, read only those
+// prefixes; deeper levels, on ranges that are small by then, follow the
+// index to the key. The elements are gathered into order at the end.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+namespace radix_detail {
+
+// bucket 0 holds keys that end at `depth`, bucket b + 1 holds byte b
+constexpr std::size_t kBuckets = 257;
+// below this a range is finished with insertion sort
+constexpr std::size_t kInsertionSort = 32;
+// below this a range is bucketed by one thread
+constexpr std::size_t kParallelPass = 1 << 16;
+
+inline std::size_t bucketOf(std::string_view key, std::size_t depth) {
+    return depth < key.size() ? static_cast<unsigned char>(key[depth]) + 1 : 0;
+}
+
+// A sort element: the index of an item in its low 32 bits, and the
+// buckets of its first kPrefixBytes key bytes in 9-bit fields above.
+using Prefixed = std::uint64_t;
+constexpr std::size_t kPrefixBytes = 3;
+constexpr unsigned kIndexBits = 32;
+constexpr unsigned kBucketBits = 9;
+
+// how the sort reads the keys of the items it orders by index
+template<typename T, typename KeyOf>
+struct PrefixedKeys {
+    const T* items;
+    const KeyOf& keyOf;
+
+    std::string_view key(Prefixed e) const {
+        return keyOf(items[e & ((Prefixed(1) << kIndexBits) - 1)]);
+    }
+    std::size_t bucket(Prefixed e, std::size_t depth) const {
+        if (depth < kPrefixBytes) {
+            unsigned shift = kIndexBits + kBucketBits * unsigned(kPrefixBytes - 1 - depth);
+            return static_cast<std::size_t>(e >> shift) & ((1u << kBucketBits) - 1);
+        }
+        return bucketOf(key(e), depth);
+    }
+
+    static Prefixed make(std::string_view key, std::size_t index) {
+        Prefixed e = 0;
+        for (std::size_t d = 0; d < kPrefixBytes; ++d) e = (e << kBucketBits) | bucketOf(key, d);
+        return (e << kIndexBits) | index;
+    }
+};
+
+template<typename T, typename Keys>
+void insertionSort(T* a, std::size_t n, std::size_t depth, const Keys& keys) {
+    // every key in the range shares its first `depth` bytes
+    auto less = [&](const T& x, const T& y) {
+        return keys.key(x).substr(depth) < keys.key(y).substr(depth);
+    };
+    for (std::size_t i = 1; i < n; ++i) {
+        T v = std::move(a[i]);
+        std::size_t j = i;
+        for (; j > 0 && less(v, a[j - 1]); --j) a[j] = std::move(a[j - 1]);
+        a[j] = std::move(v);
+    }
+}
+
+// one thread: sorts a[0, n) whose keys share their first `depth` bytes,
+// using tmp[0, n) as scatter space. Keys with long common prefixes make
+// the bucket chain as deep as the prefix, so instead of recursing the sort
+// keeps the ranges still to do on an explicit stack: it carries on with
+// the largest bucket of a pass itself and pushes the others.
+template<typename T, typename Keys>
+void msdSort(T* a, T* tmp, std::size_t n, std::size_t depth, const Keys& keys) {
+    if (n < kInsertionSort) {
+        insertionSort(a, n, depth, keys);
+        return;
+    }
+    struct Range {
+        std::size_t first, size, depth;
+    };
+    std::vector<Range> todo{{0, n, depth}};
+    std::array<std::size_t, kBuckets> next;
+    std::array<std::size_t, kBuckets + 1> start;
+    while (!todo.empty()) {
+        auto [first, size, at] = todo.back();
+        todo.pop_back();
+        for (;;) {
+            T* from = a + first;
+            if (size < kInsertionSort) {
+                insertionSort(from, size, at, keys);
+                break;
+            }
+            for (;; ++at) {
+                next.fill(0);
+                for (std::size_t i = 0; i < size; ++i) ++next[keys.bucket(from[i], at)];
+                // a byte every key shares: nothing would move, go to the next one
+                auto most = std::max_element(next.begin() + 1, next.end());
+                if (*most != size) break;
+            }
+            start[0] = 0;
+            for (std::size_t b = 0; b < kBuckets; ++b) start[b + 1] = start[b] + next[b];
+            std::copy(start.begin(), start.end() - 1, next.begin());
+            T* to = tmp + first;
+            for (std::size_t i = 0; i < size; ++i)
+                to[next[keys.bucket(from[i], at)]++] = std::move(from[i]);
+            std::move(to, to + size, from);
+            // bucket 0 are identical keys and needs no further work
+            std::size_t largest = 0;
+            for (std::size_t b = 1; b < kBuckets; ++b)
+                if (start[b + 1] - start[b] > start[largest + 1] - start[largest]) largest = b;
+            for (std::size_t b = 1; b < kBuckets; ++b) {
+                std::size_t length = start[b + 1] - start[b];
+                if (b != largest && length > 1) todo.push_back({first + start[b], length, at + 1});
+            }
+            size = start[largest + 1] - start[largest];
+            if (largest == 0 || size < 2) break;
+            first += start[largest];
+            ++at;
+        }
+    }
+}
+
+// Sorts a[0, n) like msdSort, with the bucketing pass itself split across
+// the pool and every resulting bucket sorted as its own task. Buckets that
+// are still large enough recurse in parallel; the largest one is carried
+// on with in this call, so the tasks nest no deeper than log2(n).
+template<typename T, typename Keys>
+void parallelMsdSort(ThreadPool& pool, T* a, T* tmp, std::size_t n, std::size_t depth,
+                     const Keys& keys) {
+    TaskGroup buckets(pool);
+    for (;; ++depth) {
+        std::size_t parts = std::min<std::size_t>(pool.concurrency(), n / kParallelPass);
+        if (parts < 2) {
+            msdSort(a, tmp, n, depth, keys);
+            break;
+        }
+
+        // per slice histograms, then offsets ordered by bucket, then slice,
+        // so each slice scatters its elements to disjoint positions
+        std::vector<std::array<std::size_t, kBuckets>> next(parts);
+        {
+            TaskGroup tasks(pool);
+            for (std::size_t t = 0; t < parts; ++t) {
+                tasks.run([&, t] {
+                    auto& hist = next[t];
+                    hist.fill(0);
+                    for (std::size_t i = n * t / parts; i < n * (t + 1) / parts; ++i)
+                        ++hist[keys.bucket(a[i], depth)];
+                });
+            }
+            tasks.wait();
+        }
+        std::array<std::size_t, kBuckets + 1> start{};
+        for (std::size_t b = 0; b < kBuckets; ++b) {
+            start[b + 1] = start[b];
+            for (std::size_t t = 0; t < parts; ++t) {
+                std::size_t k = next[t][b];
+                next[t][b] = start[b + 1];
+                start[b + 1] += k;
+            }
+        }
+        {
+            TaskGroup tasks(pool);
+            for (std::size_t t = 0; t < parts; ++t) {
+                tasks.run([&, t] {
+                    auto& pos = next[t];
+                    std::size_t end = n * (t + 1) / parts;
+                    for (std::size_t i = n * t / parts; i < end; ++i)
+                        tmp[pos[keys.bucket(a[i], depth)]++] = std::move(a[i]);
+                });
+            }
+            tasks.wait();
+        }
+        {
+            TaskGroup tasks(pool);
+            for (std::size_t t = 0; t < parts; ++t) {
+                tasks.run([&, t] {
+                    std::move(tmp + n * t / parts, tmp + n * (t + 1) / parts, a + n * t / parts);
+                });
+            }
+            tasks.wait();
+        }
+
+        std::size_t largest = 0;
+        for (std::size_t b = 1; b < kBuckets; ++b)
+            if (start[b + 1] - start[b] > start[largest + 1] - start[largest]) largest = b;
+        for (std::size_t b = 1; b < kBuckets; ++b) {
+            std::size_t first = start[b], size = start[b + 1] - start[b];
+            if (b == largest || size < 2) continue;
+            buckets.run([&pool, a, tmp, first, size, depth, &keys] {
+                parallelMsdSort(pool, a + first, tmp + first, size, depth + 1, keys);
+            });
+        }
+        std::size_t size = start[largest + 1] - start[largest];
+        if (largest == 0 || size < 2) break;
+        a += start[largest];
+        tmp += start[largest];
+        n = size;
+    }
+    buckets.wait();
+}
+
+// how the sort reads the keys of items it moves directly
+template<typename KeyOf>
+struct DirectKeys {
+    const KeyOf& keyOf;
+
+    template<typename T>
+    std::string_view key(const T& e) const { return keyOf(e); }
+    template<typename T>
+    std::size_t bucket(const T& e, std::size_t depth) const { return bucketOf(keyOf(e), depth); }
+};
+
+// runs f(first, last) over slices of [0, n) on the pool
+template<typename F>
+void forSlices(ThreadPool& pool, std::size_t n, const F& f) {
+    std::size_t parts = std::max<std::size_t>(1, std::min<std::size_t>(pool.concurrency(),
+                                                                       n / kParallelPass));
+    TaskGroup tasks(pool);
+    for (std::size_t t = 0; t < parts; ++t)
+        tasks.run([&, t] { f(n * t / parts, n * (t + 1) / parts); });
+    tasks.wait();
+}
+
+}  // namespace radix_detail
+
+// Sorts `items` by the bytes of keyOf(item), A -> Z.
+template<typename T, typename KeyOf>
+void parallelRadixSort(ThreadPool& pool, std::vector<T>& items, const KeyOf& keyOf) {
+    using namespace radix_detail;
+    std::size_t n = items.size();
+    if (n >= (std::size_t(1) << kIndexBits)) {
+        // too many for a 32-bit index: sort the elements themselves
+        std::vector<T> scratch(n);
+        parallelMsdSort(pool, items.data(), scratch.data(), n, 0, DirectKeys<KeyOf>{keyOf});
+        return;
+    }
+    using Keys = PrefixedKeys<T, KeyOf>;
+    std::vector<Prefixed> order(n), scratch(n);
+    forSlices(pool, n, [&](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) order[i] = Keys::make(keyOf(items[i]), i);
+    });
+    parallelMsdSort(pool, order.data(), scratch.data(), n, 0, Keys{items.data(), keyOf});
+    scratch = {};
+    std::vector<T> sorted(n);
+    forSlices(pool, n, [&](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i)
+            sorted[i] = std::move(items[order[i] & ((Prefixed(1) << kIndexBits) - 1)]);
+    });
+    items = std::move(sorted);
+}
@@ -0,0 +1,34 @@
+// src/ranged_counts.hpp
+//
+// An A -> Z word list that is never held in memory whole: after a count
+// spilled (spill.hpp) the list is the k-way merge of the runs on disk, cut
+// into key ranges that are read on their own. Every range is sized up
+// front, so a writer knows where each range's output goes before reading
+// any of it, and writes the ranges concurrently from small buffers.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+struct CountRange {
+    std::uint64_t words = 0;        // distinct words in the range
+    std::uint64_t keyBytes = 0;     // their bytes
+    std::uint64_t countDigits = 0;  // decimal digits of their counts
+};
+
+class RangedCounts {
+public:
+    using Visitor = std::function<void(std::string_view word, std::uint64_t count)>;
+
+    virtual ~RangedCounts() = default;
+
+    virtual std::size_t rangeCount() const = 0;
+    virtual const CountRange& range(std::size_t r) const = 0;
+
+    // Calls f(word, count) for every word of range r, A -> Z. Ranges may
+    // be read concurrently; a word's view is valid during the call only.
+    virtual void forEach(std::size_t r, const Visitor& f) const = 0;
+};
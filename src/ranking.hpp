@@ -0,0 +1,167 @@
+// src/ranking.hpp
+//
+// Frequency ranking for output2.txt. Both functions work on positions
+// 0..n-1 of a word list (read through `countOf(i)`) and return positions,
+// so the words themselves are never copied or moved. Ties are broken by
+// position: with an alphabetically sorted list, equal counts come out
+// A -> Z, and the top-K result is exactly a prefix of the full ranking.
+//
+// Word counts are Zipf-distributed: almost the whole vocabulary has a
+// small count and only a few thousand words have a large one. The full
+// ranking is therefore a parallel counting sort over small counts, plus an
+// ordinary comparison sort for the short tail of large ones.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+namespace ranking_detail {
+
+// counts below this go through the counting buckets
+constexpr std::uint64_t kBucketedCounts = 4096;
+// do not split a list into slices smaller than this
+constexpr std::size_t kMinSlice = 1 << 16;
+
+struct Slice {
+    std::size_t begin, end;
+};
+
+// splits [0, n) into roughly equal slices, at most one per pool thread
+inline std::vector<Slice> slicesFor(ThreadPool& pool, std::size_t n) {
+    std::size_t parts = std::min<std::size_t>(pool.concurrency(), (n + kMinSlice - 1) / kMinSlice);
+    parts = std::max<std::size_t>(parts, 1);
+    std::vector<Slice> slices(parts);
+    for (std::size_t t = 0; t < parts; ++t)
+        slices[t] = {n * t / parts, n * (t + 1) / parts};
+    return slices;
+}
+
+// "a ranks before b": higher count first, then lower position
+template<typename CountOf>
+struct RanksBefore {
+    const CountOf& countOf;
+    bool operator()(std::size_t a, std::size_t b) const {
+        auto ca = countOf(a), cb = countOf(b);
+        return ca != cb ? ca > cb : a < b;
+    }
+};
+
+}  // namespace ranking_detail
+
+// Returns every position in [0, n), highest count first.
+template<typename CountOf>
+std::vector<std::size_t> rankByFrequency(ThreadPool& pool, std::size_t n, const CountOf& countOf) {
+    using namespace ranking_detail;
+    constexpr std::size_t B = kBucketedCounts;
+    auto slices = slicesFor(pool, n);
+    std::size_t parts = slices.size();
+
+    // 1. per slice: a histogram of the small counts, and the positions of
+    //    the large ones (in order, so they stay stable)
+    std::vector<std::vector<std::size_t>> histograms(parts, std::vector<std::size_t>(B, 0));
+    std::vector<std::vector<std::size_t>> large(parts);
+    {
+        TaskGroup tasks(pool);
+        for (std::size_t t = 0; t < parts; ++t) {
+            tasks.run([&, t] {
+                auto& hist = histograms[t];
+                for (std::size_t i = slices[t].begin; i < slices[t].end; ++i) {
+                    std::uint64_t c = countOf(i);
+                    if (c < B) ++hist[c];
+                    else large[t].push_back(i);
+                }
+            });
+        }
+        tasks.wait();
+    }
+
+    // 2. the large-count tail is small; comparison-sort it up front
+    std::vector<std::size_t> ranked;
+    ranked.reserve(n);
+    for (auto const& l : large) ranked.insert(ranked.end(), l.begin(), l.end());
+    std::sort(ranked.begin(), ranked.end(), RanksBefore<CountOf>{countOf});
+    std::size_t head = ranked.size();
+    ranked.resize(n);
+
+    // 3. exclusive prefix sums: buckets from high count to low, and within
+    //    one bucket the slices in order, which keeps the sort stable
+    std::size_t offset = head;
+    for (std::size_t c = B; c-- > 0;) {
+        for (std::size_t t = 0; t < parts; ++t) {
+            std::size_t k = histograms[t][c];
+            histograms[t][c] = offset;
+            offset += k;
+        }
+    }
+
+    // 4. every slice scatters its small-count positions into place
+    {
+        TaskGroup tasks(pool);
+        for (std::size_t t = 0; t < parts; ++t) {
+            tasks.run([&, t] {
+                auto& next = histograms[t];
+                for (std::size_t i = slices[t].begin; i < slices[t].end; ++i) {
+                    std::uint64_t c = countOf(i);
+                    if (c < B) ranked[next[c]++] = i;
+                }
+            });
+        }
+        tasks.wait();
+    }
+    return ranked;
+}
+
+// Returns the `k` highest-count positions in [0, n) (all of them if
+// k >= n), highest first. Every slice selects its own top k in parallel;
+// the sorted candidate lists are then merged through a heap.
+template<typename CountOf>
+std::vector<std::size_t> topByFrequency(ThreadPool& pool, std::size_t n, std::size_t k,
+                                        const CountOf& countOf) {
+    using namespace ranking_detail;
+    RanksBefore<CountOf> before{countOf};
+    auto slices = slicesFor(pool, n);
+    std::size_t parts = slices.size();
+
+    std::vector<std::vector<std::size_t>> candidates(parts);
+    {
+        TaskGroup tasks(pool);
+        for (std::size_t t = 0; t < parts; ++t) {
+            tasks.run([&, t] {
+                auto& mine = candidates[t];
+                mine.resize(slices[t].end - slices[t].begin);
+                for (std::size_t i = 0; i < mine.size(); ++i) mine[i] = slices[t].begin + i;
+                std::size_t keep = std::min(k, mine.size());
+                std::partial_sort(mine.begin(), mine.begin() + keep, mine.end(), before);
+                mine.resize(keep);
+            });
+        }
+        tasks.wait();
+    }
+
+    // heap of (slice, cursor) pairs keyed by the candidate under the cursor
+    struct Head {
+        std::size_t slice, cursor;
+    };
+    auto worse = [&](Head const& a, Head const& b) {
+        return before(candidates[b.slice][b.cursor], candidates[a.slice][a.cursor]);
+    };
+    std::priority_queue<Head, std::vector<Head>, decltype(worse)> heap(worse);
+    for (std::size_t t = 0; t < parts; ++t)
+        if (!candidates[t].empty()) heap.push({t, 0});
+
+    std::vector<std::size_t> top;
+    top.reserve(std::min(k, n));
+    while (top.size() < k && !heap.empty()) {
+        Head h = heap.top();
+        heap.pop();
+        top.push_back(candidates[h.slice][h.cursor]);
+        if (++h.cursor < candidates[h.slice].size()) heap.push(h);
+    }
+    return top;
+}
@@ -0,0 +1,255 @@
+// src/result_file.cpp
+
+#include "result_file.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// words are gathered into buffers of this size before each write
+constexpr std::size_t kBlobBuffer = std::size_t(1) << 20;
+
+// writes all of buf; returns 0 or the errno of the failure
+int writeAll(int fd, const void* data, std::size_t size) {
+    const char* buf = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::write(fd, buf, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        buf += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return 0;
+}
+
+// the same at `offset`, leaving the file position alone
+int writeAllAt(int fd, const void* data, std::size_t size, std::uint64_t offset) {
+    const char* buf = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, buf, size, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        buf += n;
+        size -= static_cast<std::size_t>(n);
+        offset += static_cast<std::uint64_t>(n);
+    }
+    return 0;
+}
+
+ResultHeader headerFor(std::uint64_t words, std::uint64_t blobBytes) {
+    ResultHeader header{};
+    std::memcpy(header.magic, kResultMagic, sizeof header.magic);
+    header.version = kResultVersion;
+    header.byteOrder = kResultByteOrder;
+    header.words = words;
+    header.blobBytes = blobBytes;
+    header.offsetsAt = sizeof(ResultHeader);
+    header.countsAt = header.offsetsAt + (words + 1) * sizeof(std::uint64_t);
+    header.blobAt = header.countsAt + words * sizeof(std::uint64_t);
+    return header;
+}
+
+}  // namespace
+
+bool writeResultFile(const std::string& path, const std::vector<CountEntry>& sorted,
+                     std::string& error) {
+    std::vector<std::uint64_t> offsets(sorted.size() + 1);
+    std::vector<std::uint64_t> counts(sorted.size());
+    for (std::size_t i = 0; i < sorted.size(); ++i) {
+        offsets[i + 1] = offsets[i] + sorted[i].key.size();
+        counts[i] = sorted[i].count;
+    }
+
+    ResultHeader header = headerFor(sorted.size(), offsets.back());
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = "could not open " + path + " for writing";
+        return false;
+    }
+    int err = writeAll(fd, &header, sizeof header);
+    if (err == 0) err = writeAll(fd, offsets.data(), offsets.size() * sizeof(std::uint64_t));
+    if (err == 0) err = writeAll(fd, counts.data(), counts.size() * sizeof(std::uint64_t));
+
+    std::vector<char> buf;
+    buf.reserve(kBlobBuffer);
+    for (std::size_t i = 0; i < sorted.size() && err == 0; ++i) {
+        std::string_view key = sorted[i].key;
+        if (buf.size() + key.size() > kBlobBuffer) {
+            err = writeAll(fd, buf.data(), buf.size());
+            buf.clear();
+        }
+        if (err != 0) break;
+        if (key.size() > kBlobBuffer)
+            err = writeAll(fd, key.data(), key.size());
+        else
+            buf.insert(buf.end(), key.begin(), key.end());
+    }
+    if (err == 0) err = writeAll(fd, buf.data(), buf.size());
+
+    if (::close(fd) != 0 && err == 0) err = errno;
+    if (err != 0) {
+        error = "could not write " + path + ": " + std::strerror(err);
+        return false;
+    }
+    return true;
+}
+
+bool writeResultFile(ThreadPool& pool, const std::string& path, const RangedCounts& counts,
+                     std::string& error) {
+    // every range's first word and first blob byte, from the sizes
+    std::size_t ranges = counts.rangeCount();
+    std::vector<std::uint64_t> firstWord(ranges + 1, 0), firstByte(ranges + 1, 0);
+    for (std::size_t r = 0; r < ranges; ++r) {
+        firstWord[r + 1] = firstWord[r] + counts.range(r).words;
+        firstByte[r + 1] = firstByte[r] + counts.range(r).keyBytes;
+    }
+    ResultHeader header = headerFor(firstWord[ranges], firstByte[ranges]);
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = "could not open " + path + " for writing";
+        return false;
+    }
+    std::atomic<int> failure{writeAll(fd, &header, sizeof header)};
+    auto report = [&](int err) {
+        int none = 0;
+        if (err != 0) failure.compare_exchange_strong(none, err);
+    };
+    // the offsets section ends with the blob size
+    report(writeAllAt(fd, &header.blobBytes, sizeof(std::uint64_t),
+                      header.countsAt - sizeof(std::uint64_t)));
+    {
+        // each range fills its slices of the three sections, a buffer of
+        // each at a time
+        TaskGroup tasks(pool);
+        for (std::size_t r = 0; r < ranges && failure.load() == 0; ++r) {
+            tasks.run([&, r] {
+                constexpr std::size_t kWords = kBlobBuffer / 8 / sizeof(std::uint64_t);
+                std::vector<std::uint64_t> offsets, wordCounts;
+                std::vector<char> blob;
+                offsets.reserve(kWords);
+                wordCounts.reserve(kWords);
+                blob.reserve(kBlobBuffer);
+                std::uint64_t word = firstWord[r], byte = firstByte[r];
+                std::uint64_t blobWritten = firstByte[r];
+                auto flushWords = [&] {
+                    std::uint64_t at = word - offsets.size();
+                    report(writeAllAt(fd, offsets.data(), offsets.size() * sizeof(std::uint64_t),
+                                      header.offsetsAt + at * sizeof(std::uint64_t)));
+                    report(writeAllAt(fd, wordCounts.data(),
+                                      wordCounts.size() * sizeof(std::uint64_t),
+                                      header.countsAt + at * sizeof(std::uint64_t)));
+                    offsets.clear();
+                    wordCounts.clear();
+                };
+                auto flushBlob = [&] {
+                    report(writeAllAt(fd, blob.data(), blob.size(), header.blobAt + blobWritten));
+                    blobWritten += blob.size();
+                    blob.clear();
+                };
+                counts.forEach(r, [&](std::string_view key, std::uint64_t count) {
+                    offsets.push_back(byte);
+                    wordCounts.push_back(count);
+                    ++word;
+                    byte += key.size();
+                    if (offsets.size() == kWords) flushWords();
+                    if (blob.size() + key.size() > kBlobBuffer) flushBlob();
+                    if (key.size() > kBlobBuffer) {
+                        report(writeAllAt(fd, key.data(), key.size(), header.blobAt + blobWritten));
+                        blobWritten += key.size();
+                    } else {
+                        blob.insert(blob.end(), key.begin(), key.end());
+                    }
+                });
+                flushWords();
+                flushBlob();
+            });
+        }
+        tasks.wait();
+    }
+
+    int err = failure.load();
+    if (::close(fd) != 0 && err == 0) err = errno;
+    if (err != 0) {
+        error = "could not write " + path + ": " + std::strerror(err);
+        return false;
+    }
+    return true;
+}
+
+bool ResultFile::open(const std::string& path, std::string& error) {
+    *this = ResultFile();
+    MappedFile file;
+    if (!file.open(path)) {
+        error = "could not open " + path;
+        return false;
+    }
+
+    ResultHeader header;
+    if (file.size() < sizeof header) {
+        error = path + " is not a word count result file";
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof header);
+    if (std::memcmp(header.magic, kResultMagic, sizeof header.magic) != 0) {
+        error = path + " is not a word count result file";
+        return false;
+    }
+    if (header.version != kResultVersion || header.byteOrder != kResultByteOrder) {
+        error = path + " has an unsupported version or byte order";
+        return false;
+    }
+
+    // every section must lie inside the file, where the header says
+    std::uint64_t words = header.words;
+    bool valid = words < file.size() / sizeof(std::uint64_t)
+        && header.offsetsAt == sizeof(ResultHeader)
+        && header.countsAt == header.offsetsAt + (words + 1) * sizeof(std::uint64_t)
+        && header.blobAt == header.countsAt + words * sizeof(std::uint64_t)
+        && header.blobAt <= file.size()
+        && header.blobBytes == file.size() - header.blobAt;
+    if (valid) {
+        auto offsets = reinterpret_cast<const std::uint64_t*>(file.data() + header.offsetsAt);
+        // word(i) is blob[offsets[i], offsets[i + 1]), so the offsets must
+        // not decrease; from 0 up to blobBytes, they then stay in the blob
+        valid = offsets[0] == 0 && offsets[words] == header.blobBytes;
+        for (std::uint64_t i = 0; valid && i < words; ++i) valid = offsets[i] <= offsets[i + 1];
+    }
+    if (!valid) {
+        error = path + " is truncated or corrupt";
+        return false;
+    }
+
+    words_ = static_cast<std::size_t>(words);
+    offsets_ = reinterpret_cast<const std::uint64_t*>(file.data() + header.offsetsAt);
+    counts_ = reinterpret_cast<const std::uint64_t*>(file.data() + header.countsAt);
+    blob_ = file.data() + header.blobAt;
+    file_ = std::move(file);
+    return true;
+}
+
+std::uint64_t ResultFile::find(std::string_view word) const {
+    std::size_t i = lowerBound(word);
+    return i < words_ && this->word(i) == word ? counts_[i] : 0;
+}
+
+std::size_t ResultFile::lowerBound(std::string_view word) const {
+    std::size_t lo = 0, hi = words_;
+    while (lo < hi) {
+        std::size_t mid = lo + (hi - lo) / 2;
+        if (this->word(mid) < word) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
@@ -0,0 +1,88 @@
+// src/result_file.hpp
+//
+// Binary form of the A -> Z word list, for jobs that look counts up
+// instead of reading output.txt. The file is meant to be mmapped and used
+// in place: every section is 8-byte aligned and stored in native byte
+// order, so opening it only validates the header.
+//
+//   ResultHeader                      64 bytes
+//   uint64 offsets[words + 1]         word i is blob[offsets[i], offsets[i+1])
+//   uint64 counts[words]
+//   char   blob[blobBytes]            the words, A -> Z, back to back
+//
+// Words are in the same bytewise order as output.txt, so a lookup is a
+// binary search over the offsets.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "ranged_counts.hpp"
+#include "sharded_counts.hpp"
+#include "thread_pool.hpp"
+
+struct ResultHeader {
+    char magic[8];               // kResultMagic
+    std::uint32_t version;       // kResultVersion
+    std::uint32_t byteOrder;     // kResultByteOrder as written by the producer
+    std::uint64_t words;
+    std::uint64_t blobBytes;
+    std::uint64_t offsetsAt;     // file offsets of the three sections
+    std::uint64_t countsAt;
+    std::uint64_t blobAt;
+    std::uint64_t reserved;
+};
+static_assert(sizeof(ResultHeader) == 64, "ResultHeader is part of the file format");
+
+constexpr char kResultMagic[8] = {'W', 'C', 'R', 'E', 'S', 'U', 'L', 'T'};
+constexpr std::uint32_t kResultVersion = 1;
+constexpr std::uint32_t kResultByteOrder = 0x01020304;
+
+// Writes `sorted` (already in A -> Z order) to `path`. On failure returns
+// false with a message in `error`.
+bool writeResultFile(const std::string& path, const std::vector<CountEntry>& sorted,
+                     std::string& error);
+
+// The same for a list read range by range (spilled counts): each range is
+// a pool task that writes its slices of the three sections in place.
+bool writeResultFile(ThreadPool& pool, const std::string& path, const RangedCounts& counts,
+                     std::string& error);
+
+// A result file mapped read-only. Words and counts are read straight from
+// the mapping; nothing is parsed or copied.
+class ResultFile {
+public:
+    // Maps and validates `path`. On failure returns false with a message in
+    // `error` and leaves the object empty.
+    bool open(const std::string& path, std::string& error);
+
+    std::size_t size() const { return words_; }
+    std::string_view word(std::size_t i) const {
+        return {blob_ + offsets_[i], static_cast<std::size_t>(offsets_[i + 1] - offsets_[i])};
+    }
+    std::uint64_t count(std::size_t i) const { return counts_[i]; }
+
+    // count of `word`, or 0 if it is not in the file
+    std::uint64_t find(std::string_view word) const;
+
+    // index of the first word not less than `word` (size() if none)
+    std::size_t lowerBound(std::string_view word) const;
+
+    // calls f(word, count) for every word, A -> Z
+    template<typename F>
+    void forEach(F&& f) const {
+        for (std::size_t i = 0; i < words_; ++i) f(word(i), counts_[i]);
+    }
+
+private:
+    MappedFile file_;
+    std::size_t words_ = 0;
+    const std::uint64_t* offsets_ = nullptr;
+    const std::uint64_t* counts_ = nullptr;
+    const char* blob_ = nullptr;
+};
@@ -0,0 +1,87 @@
+// src/sharded_counts.cpp
+
+#include "sharded_counts.hpp"
+
+#include <algorithm>
+
+#include "result_file.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+// words of a result file partitioned by one task
+constexpr std::size_t kResultSlice = std::size_t(1) << 18;
+
+}  // namespace
+
+ShardedCounts::ShardedCounts(ThreadPool& pool, unsigned int shards, std::size_t expectedWords)
+    : nodes_(pool.nodeCount()) {
+    if (shards == 0) shards = 1;
+    shards_.resize(shards);
+    // a page is placed on the node of the thread that touches it first
+    TaskGroup tasks(pool);
+    for (unsigned int i = 0; i < shards; ++i)
+        tasks.run([this, i, expected = expectedWords / shards] { shards_[i].reserve(expected); },
+                  nodeOf(i));
+    tasks.wait();
+}
+
+void ShardedCounts::partition(const CountTable& table, ShardedEntries& out) const {
+    out.resize(shards_.size());
+    for (auto& list : out) list.clear();
+    table.forEach([&](std::string_view key, std::size_t count, std::uint64_t hash) {
+        out[shardOf(hash)].push_back({key, hash, count});
+    });
+}
+
+void ShardedCounts::mergeShard(unsigned int shard, const std::vector<ShardedEntries>& parts) {
+    WordDictionary& target = shards_[shard];
+    for (auto const& part : parts) {
+        if (shard >= part.size()) continue;  // that thread had no chunk this batch
+        for (auto const& e : part[shard])
+            target.add(e.key, e.hash, e.count);
+    }
+}
+
+void ShardedCounts::mergeResultFile(ThreadPool& pool, const ResultFile& file) {
+    std::size_t slices = (file.size() + kResultSlice - 1) / kResultSlice;
+    std::vector<ShardedEntries> parts(slices);
+    {
+        TaskGroup tasks(pool);
+        for (std::size_t s = 0; s < slices; ++s) {
+            tasks.run([&, s] {
+                ShardedEntries& out = parts[s];
+                out.resize(shards_.size());
+                std::size_t end = std::min(file.size(), (s + 1) * kResultSlice);
+                for (std::size_t i = s * kResultSlice; i < end; ++i) {
+                    // a zero count adds no word
+                    if (file.count(i) == 0) continue;
+                    std::string_view key = file.word(i);
+                    std::uint64_t hash = CountTable::hashOf(key);
+                    out[shardOf(hash)].push_back({key, hash, file.count(i)});
+                }
+            });
+        }
+        tasks.wait();
+    }
+    TaskGroup tasks(pool);
+    for (unsigned int shard = 0; shard < shardCount(); ++shard)
+        tasks.run([this, &parts, shard] { mergeShard(shard, parts); }, nodeOf(shard));
+    tasks.wait();
+}
+
+std::size_t ShardedCounts::size() const {
+    std::size_t total = 0;
+    for (auto const& s : shards_) total += s.size();
+    return total;
+}
+
+std::size_t ShardedCounts::bytesInUse() const {
+    std::size_t total = 0;
+    for (auto const& s : shards_) total += s.bytesInUse();
+    return total;
+}
+
+void ShardedCounts::clear() {
+    for (auto& s : shards_) s.clear();
+}
@@ -0,0 +1,83 @@
+// src/sharded_counts.hpp
+//
+// Ownership-partitioned reduce. The global word table is split into
+// independent shards chosen by hash; every map thread scatters its local
+// counts into one list per shard, and shard i is then merged from all of
+// those lists by exactly one task. No two threads ever touch the same
+// shard, so the reduce needs no locks.
+//
+// On a pinned multi-node pool each shard belongs to one NUMA node: its
+// table is allocated by a thread of that node and always merged there, so
+// a node's inserts and probes stay in its own memory, and the only cross-
+// node traffic is the sequential read of other nodes' entry lists.
+//
+// The shards are WordDictionary tables: every word gets a dense ID in its
+// shard, and the entries of a shard are one array in ID order.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "count_table.hpp"
+#include "word_dictionary.hpp"
+
+class ResultFile;
+class ThreadPool;
+
+struct CountEntry {
+    std::string_view key;
+    std::uint64_t hash;
+    std::uint64_t count;
+};
+
+// per map thread: its entries, bucketed by destination shard
+using ShardedEntries = std::vector<std::vector<CountEntry>>;
+
+class ShardedCounts {
+public:
+    // allocates each shard's table for its share of `expectedWords` on a
+    // thread of the shard's node
+    ShardedCounts(ThreadPool& pool, unsigned int shards, std::size_t expectedWords);
+
+    unsigned int shardCount() const { return static_cast<unsigned int>(shards_.size()); }
+    unsigned int shardOf(std::uint64_t hash) const {
+        return static_cast<unsigned int>(hash % shards_.size());
+    }
+    // the NUMA node whose threads own shard `shard`
+    unsigned int nodeOf(unsigned int shard) const { return shard % nodes_; }
+
+    // Buckets every entry of `table` by destination shard into `out`
+    // (which is resized to shardCount() lists and cleared first).
+    void partition(const CountTable& table, ShardedEntries& out) const;
+
+    // Adds shard `shard`'s list from each of `parts` into that shard's
+    // table. Safe to run concurrently for different shards; best run on
+    // a thread of nodeOf(shard).
+    void mergeShard(unsigned int shard, const std::vector<ShardedEntries>& parts);
+
+    // Adds every word of a result file (e.g. an earlier run's checkpoint)
+    // on `pool`: slices of the file are partitioned in parallel, then each
+    // shard is merged by one task. Words are copied, so the file can be
+    // closed afterwards.
+    void mergeResultFile(ThreadPool& pool, const ResultFile& file);
+
+    const WordDictionary& shard(unsigned int i) const { return shards_[i]; }
+    std::size_t size() const;
+    std::size_t bytesInUse() const;
+
+    // empties every shard (keeping their capacity), e.g. after a spill
+    void clear();
+
+    // calls f(key, count, hash) for every word in every shard
+    template<typename F>
+    void forEach(F&& f) const {
+        for (auto const& s : shards_) s.forEach(f);
+    }
+
+private:
+    std::vector<WordDictionary> shards_;
+    unsigned int nodes_;
+};
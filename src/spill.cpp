@@ -0,0 +1,107 @@
+// src/spill.cpp
+
+#include "spill.hpp"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+
+#include "count_table.hpp"
+#include "radix_sort.hpp"
+
+namespace {
+
+// the merge splits the key space into this many ranges per pool thread
+constexpr std::size_t kRangesPerThread = 4;
+// but no range gets fewer words (of the largest run) than this
+constexpr std::size_t kMinRange = 1 << 14;
+
+}  // namespace
+
+SpillRuns::SpillRuns(std::string directory) : directory_(std::move(directory)) {}
+
+SpillRuns::~SpillRuns() {
+    for (auto const& path : paths_) ::unlink(path.c_str());
+}
+
+bool SpillRuns::spill(ThreadPool& pool, ShardedCounts& counts, std::string& error) {
+    std::string path = directory_ + "/wordcount-spill-XXXXXX";
+    int fd = ::mkstemp(path.data());
+    if (fd < 0) {
+        error = "could not create a spill file in " + directory_ + ": " + std::strerror(errno);
+        return false;
+    }
+    ::close(fd);
+    paths_.push_back(path);
+
+    std::vector<CountEntry> sorted;
+    sorted.reserve(counts.size());
+    counts.forEach([&](std::string_view word, std::size_t count, std::uint64_t hash) {
+        sorted.push_back({word, hash, count});
+    });
+    parallelRadixSort(pool, sorted, [](CountEntry const& e) { return e.key; });
+    if (!writeResultFile(path, sorted, error)) return false;
+    counts.clear();
+    return true;
+}
+
+bool SpillRuns::openMerged(ThreadPool& pool, std::string& error) {
+    runs_.resize(paths_.size());
+    for (std::size_t r = 0; r < paths_.size(); ++r)
+        if (!runs_[r].open(paths_[r], error)) return false;
+
+    std::size_t largest = 0;
+    for (std::size_t r = 1; r < runs_.size(); ++r)
+        if (runs_[r].size() > runs_[largest].size()) largest = r;
+    const ResultFile& guide = runs_[largest];
+    std::size_t ranges = std::max<std::size_t>(1, std::min<std::size_t>(
+        pool.concurrency() * kRangesPerThread, guide.size() / kMinRange));
+
+    bounds_.assign(ranges + 1, std::vector<std::size_t>(runs_.size()));
+    for (std::size_t r = 0; r < runs_.size(); ++r) {
+        bounds_[0][r] = 0;
+        bounds_[ranges][r] = runs_[r].size();
+        for (std::size_t p = 1; p < ranges; ++p)
+            bounds_[p][r] = runs_[r].lowerBound(guide.word(guide.size() * p / ranges));
+    }
+    return true;
+}
+
+bool SpillRuns::merge(ThreadPool& pool, std::vector<CountEntry>& merged, std::string& error) {
+    if (!openMerged(pool, error)) return false;
+    std::size_t ranges = mergedRanges();
+
+    // the list is never held twice: every range is merged straight into
+    // its place, found by counting the ranges' words first
+    std::vector<std::size_t> at(ranges + 1, 0);
+    {
+        TaskGroup tasks(pool);
+        for (std::size_t p = 0; p < ranges; ++p)
+            tasks.run([&, p] {
+                std::size_t words = 0;
+                forEachMerged(p, [&](std::string_view, std::uint64_t) { ++words; });
+                at[p + 1] = words;
+            });
+        tasks.wait();
+    }
+    for (std::size_t p = 0; p < ranges; ++p) at[p + 1] += at[p];
+    merged.clear();
+    merged.shrink_to_fit();
+    merged.resize(at[ranges]);
+    {
+        TaskGroup tasks(pool);
+        for (std::size_t p = 0; p < ranges; ++p)
+            tasks.run([&, p] {
+                CountEntry* out = merged.data() + at[p];
+                forEachMerged(p, [&](std::string_view word, std::uint64_t count) {
+                    *out++ = {word, CountTable::hashOf(word), count};
+                });
+            });
+        tasks.wait();
+    }
+    return true;
+}
@@ -0,0 +1,102 @@
+// src/spill.hpp
+//
+// Bounded-memory support for vocabularies larger than RAM. When the global
+// table grows past the memory limit, its words are sorted and written to a
+// temporary run file (the binary result format) and the table starts over
+// empty. At the end the runs are mapped and k-way merged back into one
+// A -> Z list, in key ranges that are read concurrently. The words stay in
+// the mapped runs, where the kernel can page them in and out; the list is
+// either streamed range by range (ranged_counts.hpp), with nothing of it
+// held in memory, or built as views and counts (CountEntry).
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "result_file.hpp"
+#include "sharded_counts.hpp"
+#include "thread_pool.hpp"
+
+namespace spill_detail {
+
+// A -> Z merge of runs[r] positions [from[r], to[r]) for every r; calls
+// f(word, count) once per distinct word, with its counts summed
+template<typename F>
+void mergeRange(const std::vector<ResultFile>& runs, const std::vector<std::size_t>& from,
+                const std::vector<std::size_t>& to, const F& f) {
+    struct Head {
+        std::string_view word;
+        std::size_t run, pos;
+    };
+    auto later = [](Head const& a, Head const& b) { return b.word < a.word; };
+    std::priority_queue<Head, std::vector<Head>, decltype(later)> heap(later);
+    for (std::size_t r = 0; r < runs.size(); ++r)
+        if (from[r] < to[r]) heap.push({runs[r].word(from[r]), r, from[r]});
+
+    while (!heap.empty()) {
+        std::string_view word = heap.top().word;
+        std::uint64_t count = 0;
+        // every run holds a word at most once, so its copies are the next
+        // heads in the heap
+        while (!heap.empty() && heap.top().word == word) {
+            Head h = heap.top();
+            heap.pop();
+            count += runs[h.run].count(h.pos);
+            if (++h.pos < to[h.run]) {
+                h.word = runs[h.run].word(h.pos);
+                heap.push(h);
+            }
+        }
+        f(word, count);
+    }
+}
+
+}  // namespace spill_detail
+
+class SpillRuns {
+public:
+    // run files are created in `directory`
+    explicit SpillRuns(std::string directory);
+    ~SpillRuns();
+
+    SpillRuns(const SpillRuns&) = delete;
+    SpillRuns& operator=(const SpillRuns&) = delete;
+
+    std::size_t runCount() const { return paths_.size(); }
+
+    // Sorts everything in `counts` into a new run and clears `counts`. On
+    // failure returns false with a message in `error`.
+    bool spill(ThreadPool& pool, ShardedCounts& counts, std::string& error);
+
+    // Maps the runs and cuts their merged A -> Z list into key ranges, at
+    // evenly spaced words of the largest run, so that every range covers
+    // a contiguous slice of each run and is merged on its own. The mapped
+    // runs stay open for the lifetime of this object.
+    bool openMerged(ThreadPool& pool, std::string& error);
+    std::size_t mergedRanges() const { return bounds_.empty() ? 0 : bounds_.size() - 1; }
+
+    // after openMerged(): calls f(word, count) for every word of key range
+    // `range`, A -> Z with the counts of a word summed; the word views the
+    // mapped runs. Ranges may be read concurrently.
+    template<typename F>
+    void forEachMerged(std::size_t range, const F& f) const {
+        spill_detail::mergeRange(runs_, bounds_[range], bounds_[range + 1], f);
+    }
+
+    // Merges all runs into `merged`, as views into the mapped runs. Each
+    // pool task merges one key range; a first pass only counts the words
+    // of every range, so each is then merged straight into its place.
+    bool merge(ThreadPool& pool, std::vector<CountEntry>& merged, std::string& error);
+
+private:
+    std::string directory_;
+    std::vector<std::string> paths_;
+    std::vector<ResultFile> runs_;
+    // bounds_[p][r]: where key range p starts in run r
+    std::vector<std::vector<std::size_t>> bounds_;
+};
@@ -0,0 +1,220 @@
+// src/thread_pool.cpp
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+// the id of the pool the calling thread is a member of (0: none), and its
+// slot there. an id rather than the pool's address, which a later pool
+// could reuse
+std::atomic<std::uint64_t> nextPoolId{1};
+thread_local std::uint64_t tlsPool = 0;
+thread_local unsigned int tlsSlot = 0;
+// set while the thread is inside a task, so nested tasks aren't timed twice
+thread_local bool tlsInTask = false;
+}
+
+ThreadPool::ThreadPool(unsigned int workers, const ThreadPlacement& placement)
+    : id_(nextPoolId.fetch_add(1)), nodes_(std::max(placement.nodes, 1u)),
+      memberCount_(workers + 1),
+      members_(new Member[workers + 1]),
+      onNode_(nodes_) {
+    for (unsigned int i = 0; i <= workers; ++i) {
+        if (i < placement.node.size()) members_[i].node = placement.node[i] % nodes_;
+        onNode_[members_[i].node].push_back(i);
+    }
+    auto cpuOf = [&](unsigned int i) { return i < placement.cpu.size() ? placement.cpu[i] : -1; };
+    // the creating thread is the last member
+    tlsPool = id_;
+    tlsSlot = workers;
+    if (cpuOf(workers) >= 0) {
+        creatorCpus_ = currentThreadCpus();
+        pinCurrentThread(cpuOf(workers));
+    }
+    threads_.reserve(workers);
+    for (unsigned int i = 0; i < workers; ++i)
+        threads_.emplace_back([this, i, cpu = cpuOf(i)] { workerLoop(i, cpu); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lg(sleepMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : threads_) t.join();
+    if (tlsPool == id_) {
+        tlsPool = 0;
+        // the creating thread: it outlives the pool, its pinning doesn't
+        if (!creatorCpus_.empty()) setCurrentThreadCpus(creatorCpus_);
+    }
+}
+
+void ThreadPool::unpinHelper() const {
+    if (!creatorCpus_.empty()) setCurrentThreadCpus(creatorCpus_);
+}
+
+unsigned int ThreadPool::currentSlot() const {
+    return tlsPool == id_ ? tlsSlot : kNoSlot;
+}
+
+void ThreadPool::submit(std::function<void()> task, unsigned int node) {
+    unsigned int self = currentSlot();
+    if (self == kNoSlot) {
+        push(shared_, std::move(task));
+        return;
+    }
+    Member* to = &members_[self];
+    if (node != kAnyNode && to->node != node % nodes_) {
+        auto const& members = onNode_[node % nodes_];
+        if (!members.empty())
+            to = &members_[members[nextOnNode_.fetch_add(1, std::memory_order_relaxed)
+                                   % members.size()]];
+    }
+    push(*to, std::move(task));
+}
+
+void ThreadPool::push(Member& to, std::function<void()>&& task) {
+    {
+        std::lock_guard<std::mutex> lg(to.mutex);
+        to.tasks.push_back(std::move(task));
+        to.size.store(to.tasks.size(), std::memory_order_relaxed);
+    }
+    queued_.fetch_add(1);
+    // a worker checks queued_ under this lock before it sleeps, so taking
+    // the lock here means it either saw the task or is waiting for the signal
+    { std::lock_guard<std::mutex> lg(sleepMutex_); }
+    wake_.notify_one();
+}
+
+bool ThreadPool::take(std::function<void()>& task, bool& stolen) {
+    auto pop = [&](Member& from, bool newest) {
+        if (from.size.load(std::memory_order_relaxed) == 0) return false;
+        std::lock_guard<std::mutex> lg(from.mutex);
+        if (from.tasks.empty()) return false;
+        if (newest) {
+            task = std::move(from.tasks.back());
+            from.tasks.pop_back();
+        } else {
+            task = std::move(from.tasks.front());
+            from.tasks.pop_front();
+        }
+        from.size.store(from.tasks.size(), std::memory_order_relaxed);
+        queued_.fetch_sub(1);
+        return true;
+    };
+    stolen = false;
+    unsigned int self = currentSlot();
+    if (self != kNoSlot && pop(members_[self], /*newest=*/true)) return true;
+    if (pop(shared_, /*newest=*/false)) return true;
+    if (self == kNoSlot) return false;
+    // the victims after this thread first, so thieves don't all hit one
+    unsigned int count = concurrency();
+    unsigned int home = members_[self].node;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (unsigned int k = 1; k < count; ++k) {
+            Member& victim = members_[(self + k) % count];
+            if ((victim.node == home) != (pass == 0)) continue;
+            if (pop(victim, /*newest=*/false)) {
+                stolen = true;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runPendingTask() {
+    std::function<void()> task;
+    bool stolen;
+    if (!take(task, stolen)) return false;
+    execute(task, stolen);
+    return true;
+}
+
+std::vector<ThreadUsage> ThreadPool::usage() const {
+    std::vector<ThreadUsage> result(concurrency());
+    for (std::size_t i = 0; i < result.size(); ++i) {
+        result[i].busy =
+            std::chrono::nanoseconds(members_[i].busyNs.load(std::memory_order_relaxed));
+        result[i].tasks = members_[i].done.load(std::memory_order_relaxed);
+        result[i].stolen = members_[i].stolen.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+void ThreadPool::execute(std::function<void()>& task, bool stolen) {
+    if (tlsInTask) {
+        task();
+        return;
+    }
+    unsigned int self = currentSlot();
+    Member& member = members_[self == kNoSlot ? memberCount_ - 1 : self];
+    auto start = std::chrono::steady_clock::now();
+    tlsInTask = true;
+    task();
+    tlsInTask = false;
+    auto busy = std::chrono::steady_clock::now() - start;
+    member.busyNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count(),
+                            std::memory_order_relaxed);
+    member.done.fetch_add(1, std::memory_order_relaxed);
+    if (stolen) member.stolen.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadPool::workerLoop(unsigned int index, int cpu) {
+    tlsPool = id_;
+    tlsSlot = index;
+    if (cpu >= 0) pinCurrentThread(cpu);
+    for (;;) {
+        std::function<void()> task;
+        bool stolen;
+        if (take(task, stolen)) {
+            execute(task, stolen);
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(sleepMutex_);
+        wake_.wait(lk, [this] { return stopping_ || queued_.load() != 0; });
+        if (stopping_ && queued_.load() == 0) return;
+    }
+}
+
+void TaskGroup::run(std::function<void()> task, unsigned int node) {
+    {
+        std::lock_guard<std::mutex> lg(mutex_);
+        ++pending_;
+    }
+    pool_.submit([this, task = std::move(task)] {
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lg(mutex_);
+        if (error && !error_) error_ = error;
+        if (--pending_ == 0) done_.notify_all();
+    }, node);
+}
+
+void TaskGroup::drain() {
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lg(mutex_);
+            if (pending_ == 0) return;
+        }
+        // help out while our tasks are queued; once the queue is empty the
+        // rest are running on other threads, so just sleep until they finish
+        if (pool_.runPendingTask()) continue;
+        std::unique_lock<std::mutex> lk(mutex_);
+        done_.wait(lk, [this] { return pending_ == 0; });
+        return;
+    }
+}
+
+void TaskGroup::wait() {
+    drain();
+    std::lock_guard<std::mutex> lg(mutex_);
+    if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
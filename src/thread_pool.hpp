@@ -0,0 +1,156 @@
+// src/thread_pool.hpp
+//
+// One pool of worker threads that lives for the whole run and executes the
+// map, merge and sort phases. Work is submitted through a TaskGroup; a
+// thread waiting on a group keeps running queued tasks instead of blocking,
+// so tasks may themselves submit and wait on sub-tasks (the recursive sort
+// does) without deadlocking the pool.
+//
+// Every member thread (the workers, and the thread that created the pool)
+// has its own deque. A member's tasks go to the back of its deque, and it
+// runs its own newest task first, whose data is still in its cache. A
+// member with nothing of its own steals the oldest task of another member,
+// so a thread slowed down by a skewed chunk or a busy neighbour on the
+// host hands its remaining work to the idle ones instead of holding up
+// the whole batch. Each deque has its own lock, which only its owner and the
+// occasional thief take. Threads outside the pool (the reader) submit to a
+// shared queue, and only run tasks from that queue while they wait.
+//
+// With a pinned placement (numa.hpp) every member belongs to a NUMA node.
+// A task submitted to a node goes to the deque of one of that node's
+// members, and thieves try their own node's deques before the others'.
+// So a node's tasks run on that node unless it falls behind.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "numa.hpp"
+
+// Time one thread spent running pool tasks (a task that waits on a group
+// and runs other tasks meanwhile is counted once).
+struct ThreadUsage {
+    std::chrono::nanoseconds busy{0};
+    std::uint64_t tasks = 0;
+    std::uint64_t stolen = 0;  // of those, taken from another thread's deque
+};
+
+class ThreadPool {
+public:
+    // a task any thread may run
+    static constexpr unsigned int kAnyNode = ~0u;
+    // currentSlot() of a thread outside the pool
+    static constexpr unsigned int kNoSlot = ~0u;
+
+    // Starts `workers` background threads. The thread that waits on a
+    // TaskGroup works too, so N-way parallelism needs N-1 workers. Worker
+    // i is placed as thread i of `placement`; if the placement has an
+    // entry more, the constructing thread is pinned to it as well, until
+    // the pool is destroyed (on that thread) and its CPUs are given back.
+    explicit ThreadPool(unsigned int workers, const ThreadPlacement& placement = {});
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // number of threads that can run tasks at once (workers + caller)
+    unsigned int concurrency() const { return memberCount_; }
+
+    // NUMA nodes of the placement; 1 when the threads aren't pinned
+    unsigned int nodeCount() const { return nodes_; }
+
+    // The calling thread's member slot: its index for a worker,
+    // concurrency() - 1 for the thread that created the pool, kNoSlot for
+    // any other. No two threads share a slot, so per-slot state needs no
+    // lock while a task uses it.
+    unsigned int currentSlot() const;
+
+    // queues `task`, on a member of `node` (taken modulo nodeCount()) if
+    // it is one; a thread outside the pool can't pick a node
+    void submit(std::function<void()> task, unsigned int node = kAnyNode);
+
+    // Runs one queued task on the calling thread: its own newest, else a
+    // stolen one. Returns false if there was none.
+    bool runPendingTask();
+
+    // one entry per worker, then one for all the other threads that ran
+    // tasks while waiting on a group (the main thread, the reader)
+    std::vector<ThreadUsage> usage() const;
+
+    // For a helper thread the pinned creating thread starts (e.g. a
+    // reader), which inherits its one CPU: lets the calling thread run
+    // where the creating thread could before the pool pinned it.
+    void unpinHelper() const;
+
+private:
+    using Queue = std::deque<std::function<void()>>;
+    struct alignas(64) Member {
+        std::mutex mutex;
+        Queue tasks;
+        std::atomic<std::size_t> size{0};  // tasks.size(), for thieves to skip empty deques
+        unsigned int node = 0;
+        std::atomic<std::int64_t> busyNs{0};
+        std::atomic<std::uint64_t> done{0};
+        std::atomic<std::uint64_t> stolen{0};
+    };
+
+    void workerLoop(unsigned int index, int cpu);
+    // moves the next task for the calling thread into `task`, in the order
+    // its own deque (newest first), the shared queue, then the oldest task
+    // of every other member, its own node's first
+    bool take(std::function<void()>& task, bool& stolen);
+    void push(Member& to, std::function<void()>&& task);
+    void execute(std::function<void()>& task, bool stolen);
+
+    std::uint64_t id_;
+    std::vector<int> creatorCpus_;  // of the creating thread; empty if not pinned
+    unsigned int nodes_;
+    unsigned int memberCount_;  // fixed before the workers start, unlike threads_
+    std::vector<std::thread> threads_;
+    std::unique_ptr<Member[]> members_;              // per worker, then the creating thread
+    std::vector<std::vector<unsigned int>> onNode_;  // member slots of each node
+    std::atomic<unsigned int> nextOnNode_{0};        // spreads node tasks over its members
+    Member shared_;                                  // tasks from threads outside the pool
+    std::atomic<std::size_t> queued_{0};             // tasks in all queues
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+};
+
+// A set of tasks submitted together and waited for together.
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool_(pool) {}
+    ~TaskGroup() { drain(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    // runs `task` on the pool, on a thread of `node` if it is one
+    void run(std::function<void()> task, unsigned int node = ThreadPool::kAnyNode);
+
+    // Blocks until every task passed to run() has finished, executing
+    // queued pool tasks meanwhile. Rethrows the first exception a task
+    // threw, if any.
+    void wait();
+
+private:
+    void drain();
+
+    ThreadPool& pool_;
+    std::size_t pending_ = 0;
+    std::mutex mutex_;
+    std::condition_variable done_;
+    std::exception_ptr error_;
+};
@@ -0,0 +1,214 @@
+// src/tokenizer.cpp
+
+#include "tokenizer.hpp"
+
+#include <fstream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WORDCOUNT_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define WORDCOUNT_NEON 1
+#endif
+
+namespace {
+
+ByteMasks wordMaskScalar(const char* p) {
+    ByteMasks m{0, 0, 0, 0, 0};
+    for (unsigned i = 0; i < 64; ++i) {
+        unsigned char b = static_cast<unsigned char>(p[i]);
+        bool high  = b >= 0x80;
+        bool cont  = (b & 0xC0) == 0x80;
+        bool lead2 = b >= 0xC3 && b <= 0xC5;
+        bool odd   = (high && !cont && !lead2) || b == 0x97 || b == 0xB7;
+        bool upper = static_cast<unsigned char>(b - 'A') < 26
+                  || (cont && b < 0x9F) || b == 0xC4 || b == 0xC5;
+        m.word  |= std::uint64_t(isWordByte(b)) << i;
+        m.cont  |= std::uint64_t(cont) << i;
+        m.lead2 |= std::uint64_t(lead2) << i;
+        m.odd   |= std::uint64_t(odd) << i;
+        m.upper |= std::uint64_t(upper) << i;
+    }
+    return m;
+}
+
+#if WORDCOUNT_X86
+// Range tests like (b - lo) < span are done as signed compares after
+// shifting lo down to -128. High bytes have the top bit set, which
+// movemask reads directly.
+
+struct Masks32 {
+    std::uint32_t word, cont, lead2, odd, upper;
+};
+
+// 0xFF where lo <= v < lo + span
+__attribute__((target("sse2")))
+inline __m128i inRange(__m128i v, int lo, int span) {
+    __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(0x80 - lo)));
+    return _mm_cmpgt_epi8(_mm_set1_epi8(static_cast<char>(-128 + span)), shifted);
+}
+
+__attribute__((target("avx2")))
+inline __m256i inRange(__m256i v, int lo, int span) {
+    __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8(static_cast<char>(0x80 - lo)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(-128 + span)), shifted);
+}
+
+__attribute__((target("sse2")))
+Masks32 classifySse2(__m128i b) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i high   = _mm_cmplt_epi8(b, zero);
+    __m128i letter = inRange(_mm_or_si128(b, _mm_set1_epi8(0x20)), 'a', 26);
+    __m128i cont   = _mm_cmpeq_epi8(_mm_and_si128(b, _mm_set1_epi8(static_cast<char>(0xC0))),
+                                    _mm_set1_epi8(static_cast<char>(0x80)));
+    __m128i lead2  = inRange(b, 0xC3, 3);
+    __m128i sign   = _mm_or_si128(_mm_cmpeq_epi8(b, _mm_set1_epi8(static_cast<char>(0x97))),
+                                  _mm_cmpeq_epi8(b, _mm_set1_epi8(static_cast<char>(0xB7))));
+    __m128i odd    = _mm_or_si128(_mm_andnot_si128(_mm_or_si128(cont, lead2), high), sign);
+    __m128i upper  = _mm_or_si128(
+        _mm_or_si128(inRange(b, 'A', 26), _mm_and_si128(cont, inRange(b, 0x80, 0x1F))),
+        inRange(b, 0xC4, 2));
+    return {static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_or_si128(letter, high))),
+            static_cast<std::uint32_t>(_mm_movemask_epi8(cont)),
+            static_cast<std::uint32_t>(_mm_movemask_epi8(lead2)),
+            static_cast<std::uint32_t>(_mm_movemask_epi8(odd)),
+            static_cast<std::uint32_t>(_mm_movemask_epi8(upper))};
+}
+
+__attribute__((target("sse2")))
+ByteMasks wordMaskSse2(const char* p) {
+    ByteMasks m{0, 0, 0, 0, 0};
+    for (unsigned i = 0; i < 64; i += 16) {
+        Masks32 c = classifySse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+        m.word  |= std::uint64_t(c.word) << i;
+        m.cont  |= std::uint64_t(c.cont) << i;
+        m.lead2 |= std::uint64_t(c.lead2) << i;
+        m.odd   |= std::uint64_t(c.odd) << i;
+        m.upper |= std::uint64_t(c.upper) << i;
+    }
+    return m;
+}
+
+__attribute__((target("avx2")))
+Masks32 classifyAvx2(__m256i b) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i high   = _mm256_cmpgt_epi8(zero, b);
+    __m256i letter = inRange(_mm256_or_si256(b, _mm256_set1_epi8(0x20)), 'a', 26);
+    __m256i cont   = _mm256_cmpeq_epi8(_mm256_and_si256(b, _mm256_set1_epi8(static_cast<char>(0xC0))),
+                                       _mm256_set1_epi8(static_cast<char>(0x80)));
+    __m256i lead2  = inRange(b, 0xC3, 3);
+    __m256i sign   = _mm256_or_si256(_mm256_cmpeq_epi8(b, _mm256_set1_epi8(static_cast<char>(0x97))),
+                                     _mm256_cmpeq_epi8(b, _mm256_set1_epi8(static_cast<char>(0xB7))));
+    __m256i odd    = _mm256_or_si256(_mm256_andnot_si256(_mm256_or_si256(cont, lead2), high), sign);
+    __m256i upper  = _mm256_or_si256(
+        _mm256_or_si256(inRange(b, 'A', 26), _mm256_and_si256(cont, inRange(b, 0x80, 0x1F))),
+        inRange(b, 0xC4, 2));
+    return {static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(letter, high))),
+            static_cast<std::uint32_t>(_mm256_movemask_epi8(cont)),
+            static_cast<std::uint32_t>(_mm256_movemask_epi8(lead2)),
+            static_cast<std::uint32_t>(_mm256_movemask_epi8(odd)),
+            static_cast<std::uint32_t>(_mm256_movemask_epi8(upper))};
+}
+
+__attribute__((target("avx2")))
+ByteMasks wordMaskAvx2(const char* p) {
+    Masks32 lo = classifyAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    Masks32 hi = classifyAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32)));
+    auto join = [](std::uint32_t l, std::uint32_t h) { return std::uint64_t(l) | (std::uint64_t(h) << 32); };
+    return {join(lo.word, hi.word), join(lo.cont, hi.cont), join(lo.lead2, hi.lead2),
+            join(lo.odd, hi.odd), join(lo.upper, hi.upper)};
+}
+#endif
+
+#if WORDCOUNT_NEON
+// no movemask on NEON: weight each 0x00/0xFF lane by its bit and add
+// across each half
+std::uint64_t movemaskNeon(uint8x16_t v) {
+    static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                        1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t bits = vandq_u8(v, vld1q_u8(weights));
+    return std::uint64_t(vaddv_u8(vget_low_u8(bits)))
+         | (std::uint64_t(vaddv_u8(vget_high_u8(bits))) << 8);
+}
+
+ByteMasks wordMaskNeon(const char* p) {
+    auto inRange = [](uint8x16_t v, unsigned lo, unsigned span) {
+        return vcltq_u8(vsubq_u8(v, vdupq_n_u8(lo)), vdupq_n_u8(span));
+    };
+    ByteMasks m{0, 0, 0, 0, 0};
+    for (unsigned i = 0; i < 64; i += 16) {
+        uint8x16_t b = vld1q_u8(reinterpret_cast<const uint8_t*>(p + i));
+        uint8x16_t high   = vcgeq_u8(b, vdupq_n_u8(0x80));
+        uint8x16_t letter = inRange(vorrq_u8(b, vdupq_n_u8(0x20)), 'a', 26);
+        uint8x16_t cont   = vceqq_u8(vandq_u8(b, vdupq_n_u8(0xC0)), vdupq_n_u8(0x80));
+        uint8x16_t lead2  = inRange(b, 0xC3, 3);
+        uint8x16_t sign   = vorrq_u8(vceqq_u8(b, vdupq_n_u8(0x97)), vceqq_u8(b, vdupq_n_u8(0xB7)));
+        uint8x16_t odd    = vorrq_u8(vbicq_u8(high, vorrq_u8(cont, lead2)), sign);
+        uint8x16_t upper  = vorrq_u8(vorrq_u8(inRange(b, 'A', 26), vandq_u8(cont, inRange(b, 0x80, 0x1F))),
+                                     inRange(b, 0xC4, 2));
+        m.word  |= movemaskNeon(vorrq_u8(letter, high)) << i;
+        m.cont  |= movemaskNeon(cont) << i;
+        m.lead2 |= movemaskNeon(lead2) << i;
+        m.odd   |= movemaskNeon(odd) << i;
+        m.upper |= movemaskNeon(upper) << i;
+    }
+    return m;
+}
+#endif
+
+std::vector<TokenizerKernel> detectKernels() {
+    std::vector<TokenizerKernel> kernels;
+#if WORDCOUNT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) kernels.push_back({"avx2", wordMaskAvx2});
+    if (__builtin_cpu_supports("sse2")) kernels.push_back({"sse2", wordMaskSse2});
+#elif WORDCOUNT_NEON
+    kernels.push_back({"neon", wordMaskNeon});
+#endif
+    kernels.push_back({"scalar", wordMaskScalar});
+    return kernels;
+}
+
+const TokenizerKernel*& activeKernel() {
+    static const TokenizerKernel* kernel = &availableTokenizerKernels().front();
+    return kernel;
+}
+
+} // namespace
+
+const std::vector<TokenizerKernel>& availableTokenizerKernels() {
+    static const std::vector<TokenizerKernel> kernels = detectKernels();
+    return kernels;
+}
+
+const TokenizerKernel& activeTokenizerKernel() {
+    return *activeKernel();
+}
+
+bool selectTokenizerKernel(std::string_view name) {
+    for (auto const& kernel : availableTokenizerKernels()) {
+        if (name == kernel.name) {
+            activeKernel() = &kernel;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool readStopwords(const std::string& path, std::vector<std::string>& words,
+                   std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "could not open " + path;
+        return false;
+    }
+    // whitespace separates the words; tokenizing them like the text is up
+    // to the caller, so they match after folding
+    for (std::string word; in >> word;) words.push_back(std::move(word));
+    if (in.bad()) {
+        error = "could not read " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,273 @@
+// src/tokenizer.hpp
+//
+// What counts as a word byte, where input may be cut without splitting a
+// word, and the tokenizer used by the map phase.
+//
+// Tokenizing runs in two steps. The kernel classifies 64 input bytes at a
+// time into a bitmask of candidate word bytes (ASCII letters and every
+// non-ASCII byte; AVX2, SSE2 or NEON, picked once at runtime, with a scalar
+// fallback), and candidate runs are read off the mask transitions. Runs
+// that are pure ASCII are words as they are. Runs containing UTF-8 are
+// decoded and split again at code points that are not letters or marks
+// (NBSP, dashes, curly quotes, ...), looked up in generated tables.
+//
+// What happens to a word after that (case folding, the ASCII-only word
+// class, length limits, stopwords) is a TokenPolicy of compile-time
+// switches: tokenize<Policy>() is instantiated once per combination, so
+// every switched-off step is absent from the loop instead of being a
+// branch in it, and the map phase picks its instantiation once per run.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "count_table.hpp"
+#include "unicode_tables.hpp"
+
+// candidate word bytes: ASCII letters and anything in a UTF-8 sequence.
+// every other byte, including digits, hyphens and spaces, separates words,
+// so input may always be cut at one of them
+inline bool isWordByte(unsigned char uch) {
+    return uch >= 0x80                                            // UTF-8 (Finnish) bytes
+        || static_cast<unsigned char>((uch | 0x20) - 'a') < 26;   // ASCII letters
+}
+
+// first position >= pos that holds a separator (or data.size()), so
+// cutting there never splits a word in half
+inline std::size_t nextWordBoundary(std::string_view data, std::size_t pos) {
+    while (pos < data.size() && isWordByte(static_cast<unsigned char>(data[pos])))
+        ++pos;
+    return pos;
+}
+
+// one past the last separator in data, or 0 if data is a single word
+inline std::size_t lastWordBoundary(std::string_view data) {
+    std::size_t pos = data.size();
+    while (pos > 0 && isWordByte(static_cast<unsigned char>(data[pos - 1])))
+        --pos;
+    return pos;
+}
+
+// Per-byte classes of one 64-byte block, bit i describing p[i].
+struct ByteMasks {
+    std::uint64_t word;   // candidate word byte: ASCII letter or >= 0x80
+    std::uint64_t cont;   // UTF-8 continuation byte (10xxxxxx)
+    std::uint64_t lead2;  // 0xC3..0xC5: lead of U+00C0..U+017F
+    std::uint64_t odd;    // any other non-ASCII lead, or the second byte
+                          // of × / ÷ (0x97, 0xB7)
+    std::uint64_t upper;  // might change under case folding
+};
+
+// Classifies exactly 64 bytes.
+using WordMaskKernel = ByteMasks (*)(const char* p);
+
+struct TokenizerKernel {
+    const char* name;   // "avx2", "sse2", "neon" or "scalar"
+    WordMaskKernel wordMask;
+};
+
+// The kernel tokenize() uses: the best one this CPU supports, detected on
+// first use, unless another was selected.
+const TokenizerKernel& activeTokenizerKernel();
+
+// Every kernel this CPU can run, best first.
+const std::vector<TokenizerKernel>& availableTokenizerKernels();
+
+// Makes the kernel called `name` the active one (for benchmarks and
+// comparisons). Returns false if this CPU can't run it. Call before any
+// thread starts tokenizing.
+bool selectTokenizerKernel(std::string_view name);
+
+// Calls onRun(begin, end, needsDecode, maybeUpper) for every run of
+// candidate word bytes in text, in order.
+//
+// needsDecode is false when the run is known, from the masks alone, to be
+// valid UTF-8 made only of ASCII letters and U+00C0..U+017F letters (which
+// covers Finnish and most Latin text); such a run is one word as it is.
+// maybeUpper is false when case folding can't change the run. With
+// AsciiOnly, only ASCII letters are word bytes, so no run needs decoding.
+template<bool AsciiOnly = false, typename F>
+void forEachWordRun(std::string_view text, F&& onRun) {
+    const WordMaskKernel wordMask = activeTokenizerKernel().wordMask;
+    const char* p = text.data();
+    const std::size_t n = text.size();
+
+    auto bitsFrom = [](unsigned i) { return i >= 64 ? 0 : ~std::uint64_t(0) << i; };
+
+    std::size_t wordStart = 0;
+    bool inWord = false;
+    std::uint64_t runSpecial = 0, runUpper = 0;  // flags collected so far
+    std::uint64_t leadCarry = 0;                 // lead2 at bit 63 of last block
+    for (std::size_t base = 0; base < n; base += 64) {
+        ByteMasks m;
+        std::uint64_t nextIsCont = 0;
+        if (n - base >= 64) {
+            m = wordMask(p + base);
+            if (n - base > 64)
+                nextIsCont = (static_cast<unsigned char>(p[base + 64]) & 0xC0) == 0x80;
+        } else {
+            // zero padding is a separator, so a word running into the end
+            // of text is closed at n by the transition below
+            char tail[64] = {};
+            std::memcpy(tail, p + base, n - base);
+            m = wordMask(tail);
+        }
+        // every non-ASCII byte is a continuation byte, a 2-byte lead or odd
+        const std::uint64_t mask = AsciiOnly ? m.word & ~(m.cont | m.lead2 | m.odd) : m.word;
+
+        // bytes the fast path can't vouch for: odd leads, continuation
+        // bytes not right after a 2-byte lead, 2-byte leads not followed
+        // by a continuation byte
+        const std::uint64_t special = AsciiOnly ? 0 : m.odd
+            | (m.cont & ~((m.lead2 << 1) | leadCarry))
+            | (m.lead2 & ~((m.cont >> 1) | (nextIsCont << 63)));
+        leadCarry = m.lead2 >> 63;
+
+        // a start is a word byte after a separator, an end is a separator
+        // after a word byte; they alternate, so consume them in turn
+        std::uint64_t prev   = (mask << 1) | (inWord ? 1u : 0u);
+        std::uint64_t starts = mask & ~prev;
+        std::uint64_t ends   = ~mask & prev;
+        unsigned segment = 0;  // where the current run starts in this block
+        while (starts | ends) {
+            if (inWord) {
+                unsigned e = static_cast<unsigned>(__builtin_ctzll(ends));
+                std::uint64_t range = bitsFrom(segment) & ~bitsFrom(e);
+                runSpecial |= special & range;
+                runUpper |= m.upper & range;
+                onRun(wordStart, base + e, runSpecial != 0, runUpper != 0);
+                ends &= ends - 1;
+            } else {
+                segment = static_cast<unsigned>(__builtin_ctzll(starts));
+                wordStart = base + segment;
+                runSpecial = runUpper = 0;
+                starts &= starts - 1;
+            }
+            inWord = !inWord;
+        }
+        if (inWord) {
+            runSpecial |= special & bitsFrom(segment);
+            runUpper |= m.upper & bitsFrom(segment);
+        }
+    }
+    if (inWord) onRun(wordStart, n, runSpecial != 0, runUpper != 0);
+}
+
+struct TokenizerOptions {
+    bool foldCase = false;   // lowercase ASCII, Latin-1 and Latin Extended-A
+    bool asciiOnly = false;  // words are runs of ASCII letters; every other byte separates
+    std::size_t minLength = 0;  // in letters; shorter words are skipped
+    std::size_t maxLength = 0;  // in letters; longer words are skipped; 0 = no limit
+    std::vector<std::string> stopwords;  // skipped; tokenized like the text
+};
+
+// The options as compile-time switches, plus whether the map phase counts
+// n-grams of the words instead of the words; tokenize() reads the first four.
+template<bool FoldCase, bool AsciiOnly, bool LengthLimits, bool Stopwords, bool NGrams>
+struct TokenPolicy {
+    static constexpr bool foldCase = FoldCase;
+    static constexpr bool asciiOnly = AsciiOnly;
+    static constexpr bool lengthLimits = LengthLimits;
+    static constexpr bool stopwords = Stopwords;
+    static constexpr bool ngrams = NGrams;
+};
+
+// The values behind the switches that have any
+struct WordFilter {
+    std::size_t minLength = 0;
+    std::size_t maxLength = SIZE_MAX;
+    const CountTable* stopwords = nullptr;  // the stopwords as they are emitted
+};
+
+// letters (code points) of a UTF-8 word: its bytes that don't continue one
+inline std::size_t letterCount(std::string_view word) {
+    std::size_t continuations = 0;
+    for (unsigned char c : word) continuations += (c & 0xC0) == 0x80;
+    return word.size() - continuations;
+}
+
+// Calls onWord(word, transient) for every word in text. A word is a view of
+// text unless transient is true: then it was case-folded into `scratch`
+// and is only valid during the call. Words outside the length limits or in
+// the stopword set (compared after folding) are skipped.
+template<typename Policy, typename F>
+void tokenize(std::string_view text, const WordFilter& filter,
+              std::string& scratch, F&& onWord) {
+    // emits text[begin, end), folded into scratch if it may change
+    auto emit = [&](std::size_t begin, std::size_t end, bool mayChange) {
+        std::string_view word = text.substr(begin, end - begin);
+        if constexpr (Policy::lengthLimits) {
+            // folding keeps the number of letters
+            std::size_t letters = letterCount(word);
+            if (letters < filter.minLength || letters > filter.maxLength) return;
+        }
+        if (!Policy::foldCase || !mayChange) {
+            if constexpr (Policy::stopwords)
+                if (filter.stopwords->contains(word)) return;
+            onWord(word, false);
+            return;
+        }
+        // folding keeps the UTF-8 length, so the word fits exactly
+        scratch.resize(word.size());
+        const auto* in = reinterpret_cast<const unsigned char*>(word.data());
+        std::size_t i = 0;
+        while (i < word.size()) {
+            char32_t cp;
+            std::size_t len = decodeUtf8(in + i, word.size() - i, cp);
+            encodeUtf8(foldLatin(cp), &scratch[i]);
+            i += len;
+        }
+        if constexpr (Policy::stopwords)
+            if (filter.stopwords->contains(scratch)) return;
+        onWord(std::string_view(scratch), true);
+    };
+
+    forEachWordRun<Policy::asciiOnly>(text, [&](std::size_t begin, std::size_t end,
+                                                bool needsDecode, bool maybeUpper) {
+        if (Policy::asciiOnly || !needsDecode) {
+            emit(begin, end, maybeUpper);
+            return;
+        }
+
+        // split the run at code points that are not letters or marks;
+        // invalid UTF-8 bytes separate words too
+        const auto* p = reinterpret_cast<const unsigned char*>(text.data());
+        std::size_t wordBegin = 0;
+        bool inWord = false;
+        bool changed = false;
+        std::size_t i = begin;
+        while (i < end) {
+            char32_t cp = p[i];
+            std::size_t len = 1;
+            bool letter = true;  // ASCII bytes in a run are always letters
+            if (cp >= 0x80) {
+                len = decodeUtf8(p + i, end - i, cp);
+                letter = len != 0 && isWordCodePoint(cp);
+                if (len == 0) len = 1;
+            }
+            if (letter) {
+                if (!inWord) {
+                    wordBegin = i;
+                    inWord = true;
+                    changed = false;
+                }
+                if constexpr (Policy::foldCase) changed |= foldLatin(cp) != cp;
+            } else if (inWord) {
+                emit(wordBegin, i, changed);
+                inWord = false;
+            }
+            i += len;
+        }
+        if (inWord) emit(wordBegin, end, changed);
+    });
+}
+
+// Reads a stopword list: the words of `path`, one or more per line.
+// Returns false with a message in `error` if it can't be read.
+bool readStopwords(const std::string& path, std::vector<std::string>& words,
+                   std::string& error);
@@ -0,0 +1,73 @@
+// src/unicode_tables.hpp
+//
+// Code point classification and case folding for the UTF-8 tokenizer.
+// The tables are generated by tools/gen_unicode_tables.py: a two-stage
+// bitset of word characters (Unicode letters and marks) and a lowercase
+// map for ASCII, Latin-1 and Latin Extended-A.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+extern const std::uint8_t kWordCharPage[0x1100];  // code point >> 8 -> block
+extern const std::uint32_t kWordCharBits[][8];    // 256 bits per block
+extern const std::uint16_t kLatinLower[0x180];
+
+// true for letters and combining marks
+inline bool isWordCodePoint(char32_t cp) {
+    if (cp >= 0x110000) return false;
+    const std::uint32_t* bits = kWordCharBits[kWordCharPage[cp >> 8]];
+    return (bits[(cp & 0xFF) >> 5] >> (cp & 31)) & 1u;
+}
+
+// lowercase for U+0000..U+017F, identity elsewhere; never changes the
+// UTF-8 length of the code point
+inline char32_t foldLatin(char32_t cp) {
+    return cp < 0x180 ? kLatinLower[cp] : cp;
+}
+
+// Decodes one UTF-8 sequence from p[0..n). Returns its length, or 0 if the
+// bytes are not valid UTF-8 (overlong forms and surrogates included); cp
+// is written either way, though then holds no meaningful code point.
+inline std::size_t decodeUtf8(const unsigned char* p, std::size_t n, char32_t& cp) {
+    unsigned char b = p[0];
+    if (b < 0x80) { cp = b; return 1; }
+    std::size_t len;
+    char32_t min;
+    if ((b & 0xE0) == 0xC0)      { len = 2; cp = b & 0x1F; min = 0x80; }
+    else if ((b & 0xF0) == 0xE0) { len = 3; cp = b & 0x0F; min = 0x800; }
+    else if ((b & 0xF8) == 0xF0) { len = 4; cp = b & 0x07; min = 0x10000; }
+    else { cp = b; return 0; }
+    if (len > n) return 0;
+    for (std::size_t i = 1; i < len; ++i) {
+        if ((p[i] & 0xC0) != 0x80) return 0;
+        cp = (cp << 6) | (p[i] & 0x3F);
+    }
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return 0;
+    return len;
+}
+
+// Writes cp as UTF-8 to out and returns the number of bytes written.
+inline std::size_t encodeUtf8(char32_t cp, char* out) {
+    if (cp < 0x80) {
+        out[0] = static_cast<char>(cp);
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (cp >> 6));
+        out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (cp >> 12));
+        out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (cp >> 18));
+    out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+    return 4;
+}
@@ -0,0 +1,900 @@
+// src/word_counter.cpp
+
+#include "word_counter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+#include "log.hpp"
+#include "radix_sort.hpp"
+#include "ranking.hpp"
+
+namespace {
+
+constexpr std::size_t kDefaultBatchBytes = std::size_t(256) << 20;
+// shards of the global table per thread, so the merge tasks balance
+constexpr unsigned int kShardsPerThread = 4;
+// bytes per map task: small enough for idle threads to steal the tail of
+// a batch, large enough that a task's setup doesn't show
+constexpr std::size_t kMapTaskBytes = std::size_t(2) << 20;
+
+unsigned int threadsFor(const WordCounterOptions& options) {
+    unsigned int threads = options.threads != 0 ? options.threads
+                                                : std::thread::hardware_concurrency();
+    return threads != 0 ? threads : 1;
+}
+
+std::size_t expectedWordsFor(const WordCounterOptions& options) {
+    if (options.approx.enabled) return 0;  // the global table stays empty
+    if (options.memoryLimit == 0) return options.expectedWords;
+    // ~64 bytes per word in the table
+    return std::min(options.expectedWords, options.memoryLimit / 64);
+}
+
+std::string spillDirFor(const WordCounterOptions& options) {
+    if (!options.spillDir.empty()) return options.spillDir;
+    const char* tmpDir = std::getenv("TMPDIR");
+    return tmpDir && *tmpDir ? tmpDir : "/tmp";
+}
+
+// One map task's input. The n-gram fields link the chunks of the stream:
+// an n-gram across a cut is counted by the chunk its first word is in,
+// which reads on into `after` as far as needed, and one across a batch
+// boundary by the first chunk of the next batch, from `before`.
+struct MapChunk {
+    std::string_view text;    // word-aligned bytes to count
+    std::size_t offset;       // of text in the input
+    const CountTable* dictionary;  // n-grams: word -> ID + 1
+    unsigned int ngram;
+    std::string_view after;   // n-grams: the rest of the batch
+    std::string_view before;  // n-grams: the last IDs before the batch, on its first chunk
+    std::string* tail;        // n-grams: the batch's last IDs, from its last chunk
+};
+
+// n-gram keys: word IDs as 4 big-endian bytes, so that keys sort like
+// their words do
+constexpr std::size_t kIdBytes = 4;
+// entries of a map task's cache of word IDs (16 bytes each)
+constexpr unsigned kIdCacheBits = 12;
+
+inline std::uint32_t idAt(const char* p) {
+    const auto* b = reinterpret_cast<const unsigned char*>(p);
+    return (std::uint32_t(b[0]) << 24) | (std::uint32_t(b[1]) << 16)
+         | (std::uint32_t(b[2]) << 8) | b[3];
+}
+
+// ————————————————————————————————————————————————————————
+// Map phase: count words in one byte range of the input
+//    now skips digits, keeps Finnish letters and hyphens
+//    returns the number of words; with `metrics`, the time spent
+//    tokenizing and counting is added to it separately.
+//    `Counter` is the thread's CountTable or the HotWordCache in front
+//    of it; `Policy` the tokenizer options (with n-grams, the runs of
+//    adjacent words are counted instead)
+// ————————————————————————————————————————————————————————
+template<typename Policy, typename F>
+void forEachKey(const MapChunk& chunk, const WordFilter& filter, std::string& scratch,
+                F&& onKey) {
+    if constexpr (!Policy::ngrams) {
+        tokenize<Policy>(chunk.text, filter, scratch, onKey);
+    } else {
+        // the IDs of the last words; once it holds n, it is an n-gram key.
+        // it starts with the IDs before the batch (`before` of them) and
+        // takes on IDs from the text (`own` of them still in it), then from
+        // `after` until the last n-gram starting in the text is counted
+        const std::size_t keyBytes = kIdBytes * chunk.ngram;
+        std::string window(chunk.before);
+        std::size_t before = window.size() / kIdBytes, own = 0;
+
+        // the IDs of recent short words, direct-mapped on the packed word as
+        // in HotWordCache: the frequent words, most of the text, then skip
+        // the probe of the dictionary, which is far larger than the caches
+        struct CachedId {
+            std::uint64_t packed = 0;
+            std::uint32_t length = 0;  // 0 marks an empty entry
+            std::uint32_t id = 0;      // ID + 1, as in the dictionary
+        };
+        std::vector<CachedId> cached(std::size_t(1) << kIdCacheBits);
+        auto idOf = [&](std::string_view word) -> std::uint64_t {
+            if (word.size() > 8) return chunk.dictionary->find(word);
+            std::uint64_t packed = HotWordCache::pack(word);
+            CachedId& c = cached[((packed + word.size()) * 0x9E3779B97F4A7C15ull)
+                                 >> (64 - kIdCacheBits)];
+            if (c.packed != packed || c.length != word.size()) {
+                c = {packed, static_cast<std::uint32_t>(word.size()),
+                     static_cast<std::uint32_t>(chunk.dictionary->find(word))};
+            }
+            return c.id;
+        };
+
+        auto push = [&](std::string_view word, bool fromText) {
+            std::uint64_t id = idOf(word);
+            if (id == 0) {
+                // a word the first pass didn't see (the input changed in
+                // between) ends every n-gram around it
+                window.clear();
+                before = own = 0;
+                return;
+            }
+            --id;
+            const char bytes[kIdBytes] = {static_cast<char>(id >> 24), static_cast<char>(id >> 16),
+                                          static_cast<char>(id >> 8), static_cast<char>(id)};
+            window.append(bytes, kIdBytes);
+            own += fromText;
+            if (window.size() < keyBytes) return;
+            onKey(std::string_view(window), true);
+            window.erase(0, kIdBytes);
+            if (before != 0)
+                --before;
+            else if (own != 0)
+                --own;
+        };
+        tokenize<Policy>(chunk.text, filter, scratch,
+                         [&](std::string_view word, bool) { push(word, true); });
+        if (chunk.tail) *chunk.tail = window;
+
+        // read on a run of word bytes at a time (skipped words don't count)
+        std::size_t at = 0;
+        while (own != 0 && at < chunk.after.size()) {
+            std::size_t start = at;
+            while (start < chunk.after.size()
+                   && !isWordByte(static_cast<unsigned char>(chunk.after[start])))
+                ++start;
+            std::size_t end = nextWordBoundary(chunk.after, start);
+            tokenize<Policy>(chunk.after.substr(at, end - at), filter, scratch,
+                             [&](std::string_view word, bool) {
+                if (own != 0) push(word, false);
+            });
+            at = end;
+        }
+    }
+}
+
+template<typename Policy, typename Counter>
+std::size_t countWords(
+    const MapChunk& chunk,
+    const WordFilter& filter,
+    Counter& localCounts,
+    RunMetrics* metrics)
+{
+    // words are counted as slices of the chunk; only case-folded words
+    // go through a scratch buffer and get copied into the table
+    std::string scratch;
+    std::size_t words = 0;
+    if (!metrics) {
+        forEachKey<Policy>(chunk, filter, scratch, [&](std::string_view word, bool transient) {
+            ++words;
+            if (transient)
+                localCounts.addTransient(word);
+            else
+                localCounts.add(word);
+        });
+        return words;
+    }
+
+    // timed: words are collected a block at a time and then counted, so the
+    // two halves can be timed apart without reading the clock per word.
+    // a pending word is at chunk[at, at + size), or in `folded` if transient
+    struct Pending { std::size_t at, size; bool transient; };
+    constexpr std::size_t BLOCK_WORDS = 4096;
+    std::vector<Pending> block;
+    block.reserve(BLOCK_WORDS);
+    std::string folded;
+    std::chrono::nanoseconds tokenizeTime{0}, countTime{0};
+    auto mark = MetricsClock::now();
+    auto flush = [&] {
+        auto counting = MetricsClock::now();
+        tokenizeTime += counting - mark;
+        for (auto const& w : block) {
+            if (w.transient)
+                localCounts.addTransient(std::string_view(folded).substr(w.at, w.size));
+            else
+                localCounts.add(chunk.text.substr(w.at, w.size));
+        }
+        words += block.size();
+        block.clear();
+        folded.clear();
+        mark = MetricsClock::now();
+        countTime += mark - counting;
+    };
+    forEachKey<Policy>(chunk, filter, scratch, [&](std::string_view word, bool transient) {
+        if (transient) {
+            block.push_back({folded.size(), word.size(), true});
+            folded.append(word);
+        } else {
+            block.push_back({static_cast<std::size_t>(word.data() - chunk.text.data()), word.size(), false});
+        }
+        if (block.size() == BLOCK_WORDS) flush();
+    });
+    flush();
+    metrics->addWork(Work::Tokenize, tokenizeTime);
+    metrics->addWork(Work::LocalCount, countTime);
+    return words;
+}
+
+template<typename Policy>
+std::size_t countWordsInChunk(
+    const MapChunk& chunk,
+    const WordFilter& filter,
+    CountTable& localCounts,
+    HotWordCache* hotWords,
+    RunMetrics* metrics)
+{
+    trace("[Map] handling bytes {}–{}", chunk.offset, chunk.offset + chunk.text.size());
+    if (!hotWords)
+        return countWords<Policy>(chunk, filter, localCounts, metrics);
+    std::size_t words = countWords<Policy>(chunk, filter, *hotWords, metrics);
+    hotWords->flush();  // localCounts is complete before it is partitioned
+    return words;
+}
+
+// Every TokenPolicy's map function; bit i of the index turns on switch i
+// (fold case, ASCII only, length limits, stopwords, n-grams)
+using MapFunction = std::size_t (*)(const MapChunk&, const WordFilter&, CountTable&,
+                                    HotWordCache*, RunMetrics*);
+
+template<std::size_t Index>
+using PolicyAt = TokenPolicy<(Index & 1) != 0, (Index & 2) != 0, (Index & 4) != 0,
+                             (Index & 8) != 0, (Index & 16) != 0>;
+
+template<std::size_t... Index>
+constexpr std::array<MapFunction, sizeof...(Index)> mapFunctions(std::index_sequence<Index...>) {
+    return {{&countWordsInChunk<PolicyAt<Index>>...}};
+}
+
+constexpr auto kMapFunctions = mapFunctions(std::make_index_sequence<32>());
+
+// the stopwords, tokenized (and folded) like the text, so they match the
+// words they are meant to skip
+template<typename Policy>
+void addStopwords(const std::vector<std::string>& words, CountTable& set) {
+    std::string scratch;
+    for (auto const& word : words)
+        tokenize<Policy>(word, WordFilter{}, scratch,
+                         [&](std::string_view w, bool) { set.addTransient(w); });
+}
+
+CountTable stopwordSetFor(const TokenizerOptions& options) {
+    CountTable set;
+    if (options.foldCase && options.asciiOnly)
+        addStopwords<TokenPolicy<true, true, false, false, false>>(options.stopwords, set);
+    else if (options.foldCase)
+        addStopwords<TokenPolicy<true, false, false, false, false>>(options.stopwords, set);
+    else if (options.asciiOnly)
+        addStopwords<TokenPolicy<false, true, false, false, false>>(options.stopwords, set);
+    else
+        addStopwords<TokenPolicy<false, false, false, false, false>>(options.stopwords, set);
+    return set;
+}
+
+std::uint64_t digitsOf(std::uint64_t v) {
+    std::uint64_t n = 1;
+    while (v >= 10) { v /= 10; ++n; }
+    return n;
+}
+
+}  // namespace
+
+// The merged spilled runs as a RangedCounts. The ranges are those of the
+// runs' merge; n-gram keys are spelled out as they are read.
+class WordCounter::SpilledResults : public RangedCounts {
+public:
+    SpilledResults(const SpillRuns& runs, const WordCounts* dictionary)
+        : runs_(runs), dictionary_(dictionary), ranges_(runs.mergedRanges()) {}
+
+    std::size_t rangeCount() const override { return ranges_.size(); }
+    const CountRange& range(std::size_t r) const override { return ranges_[r]; }
+
+    void forEach(std::size_t r, const Visitor& f) const override {
+        if (dictionary_ == nullptr) {
+            runs_.forEachMerged(r, f);
+            return;
+        }
+        std::string words;
+        runs_.forEachMerged(r, [&](std::string_view key, std::uint64_t count) {
+            words.clear();
+            for (std::size_t i = 0; i < key.size(); i += kIdBytes) {
+                if (i != 0) words.push_back(' ');
+                words.append((*dictionary_)[idAt(key.data() + i)].key);
+            }
+            f(words, count);
+        });
+    }
+
+    // reads every range once, on the pool, to size it
+    void measure(ThreadPool& pool) {
+        TaskGroup tasks(pool);
+        for (std::size_t r = 0; r < ranges_.size(); ++r)
+            tasks.run([this, r] {
+                CountRange& range = ranges_[r];
+                forEach(r, [&](std::string_view word, std::uint64_t count) {
+                    ++range.words;
+                    range.keyBytes += word.size();
+                    range.countDigits += digitsOf(count);
+                });
+            });
+        tasks.wait();
+    }
+
+    std::uint64_t words() const {
+        std::uint64_t words = 0;
+        for (auto const& range : ranges_) words += range.words;
+        return words;
+    }
+
+private:
+    const SpillRuns& runs_;
+    const WordCounts* dictionary_;
+    std::vector<CountRange> ranges_;
+};
+
+std::uint64_t WordCounts::count(std::string_view word) const {
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), word,
+                               [](CountEntry const& e, std::string_view w) { return e.key < w; });
+    return it != entries_.end() && it->key == word ? it->count : 0;
+}
+
+WordCounter::WordCounter(const WordCounterOptions& options)
+    : options_(options),
+      threads_(threadsFor(options)),
+      batchBytes_(options.batchBytes != 0 ? options.batchBytes : kDefaultBatchBytes),
+      localExpected_(batchBytes_ / 1000 / threads_),
+      placement_(placeThreads(threads_, options.pinning)),
+      pool_(threads_ - 1, placement_),
+      global_(pool_, threads_ * kShardsPerThread, expectedWordsFor(options)),
+      spills_(spillDirFor(options)),
+      stopwords_(stopwordSetFor(options.tokenizer)),
+      pendingLimit_(batchBytes_),
+      merges_(pool_) {
+    metrics_.threads = threads_;
+    const TokenizerOptions& tokenizer = options_.tokenizer;
+    bool lengthLimits = tokenizer.minLength != 0 || tokenizer.maxLength != 0;
+    filter_.minLength = tokenizer.minLength;
+    if (tokenizer.maxLength != 0) filter_.maxLength = tokenizer.maxLength;
+    filter_.stopwords = &stopwords_;
+    mapPolicy_ = (tokenizer.foldCase ? 1u : 0u) | (tokenizer.asciiOnly ? 2u : 0u)
+        | (lengthLimits ? 4u : 0u) | (!stopwords_.empty() ? 8u : 0u)
+        | (options_.ngram > 1 ? 16u : 0u);
+
+    // the dictionary borrows the caller's words; an ID is stored plus one,
+    // since a count of 0 marks an empty slot
+    if (options_.ngram > 1 && options_.dictionary) {
+        dictionary_ = CountTable(options_.dictionary->size(), /*borrowKeys=*/true);
+        for (std::size_t id = 0; id < options_.dictionary->size(); ++id) {
+            const CountEntry& e = (*options_.dictionary)[id];
+            dictionary_.add(e.key, e.hash, id + 1);
+        }
+    }
+    // local keys are views into the batch itself (mapped file or read
+    // buffer), which stays alive until the batch is merged, so the map
+    // phase never copies a word; the global tables copy each distinct
+    // word once into their own arena
+    for (unsigned int s = 0; s < 2; ++s) {
+        for (unsigned int t = 0; t <= threads_; ++t)
+            tables_[s].emplace_back(0, /*borrowKeys=*/true);
+        if (options_.hotWordCache)
+            for (auto& table : tables_[s]) hotWords_[s].emplace_back(table);
+        shards_[s].resize(threads_ + 1);
+    }
+    // allocated by summarize(), on the node of the thread that fills them
+    if (options_.approx.enabled) {
+        sketches_.resize(threads_ + 1);
+        heavyHitters_.resize(threads_ + 1);
+    }
+}
+
+WordCounter::~WordCounter() = default;
+
+// Map phase on one batch: the batch is cut into tasks of about
+// kMapTaskBytes (at least one per thread), queued in order on the
+// threads' home nodes. a thread that finishes its chunks early steals
+// queued ones from the others, so a slow thread holds up the batch by at
+// most one small chunk instead of a whole per-thread share. every task
+// counts into the table of the pool slot running it, which reserves the
+// table on first use, so its pages are placed in that thread's node
+// memory (first touch). the tables are then bucketed by shard, one task
+// per table
+void WordCounter::mapBatch(const Batch& batch) {
+    std::vector<CountTable>& localCounts = tables_[current_];
+    std::vector<HotWordCache>& hotWords = hotWords_[current_];
+    std::vector<ShardedEntries>& localShards = shards_[current_];
+    RunMetrics* chunkMetrics = options_.detailedTiming ? &metrics_ : nullptr;
+    std::size_t tasks = std::max<std::size_t>(
+        threads_, (batch.data.size() + kMapTaskBytes - 1) / kMapTaskBytes);
+    std::size_t bytesPerTask = (batch.data.size() + tasks - 1) / tasks;
+
+    for (auto& m : localCounts)
+        m.clear();
+    for (auto& part : localShards)
+        part.clear();
+    const MapFunction countWordsInChunk = kMapFunctions[mapPolicy_];
+    std::string tail;  // n-grams: becomes tail_ once the batch is mapped
+    TaskGroup mapTasks(pool_);
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < tasks && start < batch.data.size(); ++i) {
+        std::size_t end = nextWordBoundary(
+            batch.data, std::min(start + bytesPerTask, batch.data.size()));
+        MapChunk chunk{batch.data.substr(start, end - start), batch.offset + start,
+                       &dictionary_, options_.ngram, batch.data.substr(end),
+                       start == 0 ? tail_ : std::string_view(),
+                       end == batch.data.size() ? &tail : nullptr};
+        mapTasks.run([&, chunk] {
+            // the last table is for a feeding thread outside the pool
+            unsigned int t = pool_.currentSlot();
+            if (t == ThreadPool::kNoSlot) t = threads_;
+            localCounts[t].reserve(localExpected_);
+            words_.fetch_add(
+                countWordsInChunk(chunk, filter_, localCounts[t],
+                                  hotWords.empty() ? nullptr : &hotWords[t], chunkMetrics),
+                std::memory_order_relaxed);
+        }, placement_.node[i * threads_ / tasks]);
+        start = end;
+    }
+    mapTasks.wait();
+    if (start != 0) tail_.swap(tail);
+
+    for (unsigned int t = 0; t <= threads_; ++t) {
+        if (localCounts[t].empty()) continue;  // that thread ran no chunk
+        if (options_.approx.enabled) {
+            mapTasks.run([&, t] {
+                auto reduceStart = MetricsClock::now();
+                summarize(localCounts[t], t);
+                metrics_.addWork(Work::Reduce, since(reduceStart));
+            }, t < threads_ ? placement_.node[t] : ThreadPool::kAnyNode);
+            continue;
+        }
+        mapTasks.run([&, t] {
+            auto shuffleStart = MetricsClock::now();
+            global_.partition(localCounts[t], localShards[t]);
+            metrics_.addWork(Work::Shuffle, since(shuffleStart));
+        }, t < threads_ ? placement_.node[t] : ThreadPool::kAnyNode);
+    }
+    mapTasks.wait();
+}
+
+bool WordCounter::usable(std::string& error) const {
+    if (finished_) {
+        error = "the counter has already finished";
+        return false;
+    }
+    if (options_.ngram > 1 && !options_.dictionary) {
+        error = "an n-gram count needs the dictionary of a first pass";
+        return false;
+    }
+    if (options_.ngram > 1 && options_.dictionary->size() >= UINT32_MAX) {
+        error = "too many distinct words for 32-bit word IDs";
+        return false;
+    }
+    if (options_.approx.enabled) {
+        const ApproxOptions& approx = options_.approx;
+        if (options_.ngram > 1) {
+            error = "n-grams can't be counted approximately";
+            return false;
+        }
+        if (!(approx.epsilon > 0 && approx.epsilon < 1) || !(approx.delta > 0 && approx.delta < 1)) {
+            error = "the approximate count's epsilon and delta must lie between 0 and 1";
+            return false;
+        }
+        if (approx.heavyHitters == 0) {
+            error = "an approximate count needs room for at least one heavy hitter";
+            return false;
+        }
+    }
+    return true;
+}
+
+void WordCounter::summarize(const CountTable& table, unsigned int t) {
+    const ApproxOptions& approx = options_.approx;
+    if (sketches_[t].empty()) {
+        sketches_[t] = CountMinSketch(approx.epsilon, approx.delta);
+        heavyHitters_[t] = SpaceSaving(approx.heavyHitters);
+    }
+    CountMinSketch& sketch = sketches_[t];
+    SpaceSaving& heavy = heavyHitters_[t];
+    table.forEach([&](std::string_view key, std::size_t count, std::uint64_t hash) {
+        sketch.add(hash, count);
+        heavy.add(key, hash, count, sketch.estimate(hash));
+    });
+}
+
+void WordCounter::mergeSummaries(CountMinSketch& sketch, SpaceSaving& heavy) {
+    const ApproxOptions& approx = options_.approx;
+    sketch = CountMinSketch(approx.epsilon, approx.delta);
+    heavy = SpaceSaving(approx.heavyHitters);
+    // every slice of counters is the sum of that slice of each sketch
+    std::size_t counters = sketch.counterCount();
+    std::size_t slices = std::min<std::size_t>(pool_.concurrency(),
+                                               std::max<std::size_t>(1, counters >> 16));
+    TaskGroup tasks(pool_);
+    for (std::size_t s = 0; s < slices; ++s) {
+        tasks.run([&, s] {
+            std::size_t first = counters * s / slices, last = counters * (s + 1) / slices;
+            for (auto const& part : sketches_)
+                if (!part.empty()) sketch.mergeCounters(part, first, last);
+        });
+    }
+    for (std::size_t t = 0; t < sketches_.size(); ++t) {
+        if (sketches_[t].empty()) continue;
+        sketch.mergeTotal(sketches_[t]);
+        heavy.merge(heavyHitters_[t]);
+    }
+    tasks.wait();
+}
+
+void WordCounter::heavyHitterCounts(const CountMinSketch& sketch, const SpaceSaving& heavy,
+                                    std::vector<CountEntry>& entries, std::string& words) {
+    // both counts are upper bounds of the true one; the smaller is kept
+    std::size_t bytes = 0;
+    heavy.forEach([&](std::string_view key, std::uint64_t, std::uint64_t, std::uint64_t) {
+        bytes += key.size();
+    });
+    words.clear();
+    words.reserve(bytes);
+    entries.clear();
+    heavy.forEach([&](std::string_view key, std::uint64_t count, std::uint64_t hash,
+                      std::uint64_t) {
+        std::size_t at = words.size();
+        words.append(key);
+        entries.push_back({std::string_view(words.data() + at, key.size()), hash,
+                           std::min(count, sketch.estimate(hash))});
+    });
+    parallelRadixSort(pool_, entries, [](CountEntry const& e) { return e.key; });
+}
+
+std::uint64_t WordCounter::estimate(std::string_view word) const {
+    return sketch_.estimate(CountTable::hashOf(word));
+}
+
+bool WordCounter::feedBatch(Batch&& batch, Batch& released, std::string& error) {
+    if (!usable(error)) return false;
+    metrics_.inputBytes += batch.inputBytes;
+    mapBatch(batch);
+    if (options_.approx.enabled) {
+        // the summaries copied the words they keep, so the batch is free
+        released = std::move(batch);
+        return true;
+    }
+
+    // batch N-1 must be fully merged before its buffer is reused
+    merges_.wait();
+    released = std::move(merging_);
+    if (!spillIfFull(error)) return false;
+
+    // Parallel Merge phase for this batch: each shard of the global table
+    // is reduced from every thread's bucket by one task, on the node that
+    // owns it, while the next batch is mapped
+    const auto& localShards = shards_[current_];
+    for (unsigned int shard = 0; shard < global_.shardCount(); ++shard) {
+        merges_.run([this, &localShards, shard] {
+            trace("[Merge] shard {} starting", shard);
+            auto reduceStart = MetricsClock::now();
+            global_.mergeShard(shard, localShards);
+            metrics_.addWork(Work::Reduce, since(reduceStart));
+            trace("[Merge] shard {} done", shard);
+        }, global_.nodeOf(shard));
+    }
+    merging_ = std::move(batch);
+    current_ ^= 1;
+    return true;
+}
+
+bool WordCounter::feed(std::string_view text, std::string& error) {
+    if (!usable(error)) return false;
+    while (!text.empty()) {
+        if (pending_.capacity() == 0 && !spare_.empty()) {
+            pending_ = std::move(spare_.back());
+            spare_.pop_back();
+            pending_.clear();
+        }
+        std::size_t take = std::min(pendingLimit_ - pending_.size(), text.size());
+        pending_.insert(pending_.end(), text.data(), text.data() + take);
+        text.remove_prefix(take);
+        if (pending_.size() == pendingLimit_ && !countPending(false, error)) return false;
+    }
+    return true;
+}
+
+bool WordCounter::countPending(bool final, std::string& error) {
+    if (pending_.empty()) return true;
+    std::size_t cut = final ? pending_.size()
+                            : lastWordBoundary(std::string_view(pending_.data(), pending_.size()));
+    if (cut == 0) {
+        // nothing complete yet (one giant word); keep filling this buffer
+        if (pending_.size() == pendingLimit_) pendingLimit_ *= 2;
+        return true;
+    }
+    pendingLimit_ = std::max(batchBytes_, pending_.size() - cut);
+
+    // the trailing partial word moves to the next buffer
+    std::vector<char> next;
+    if (!spare_.empty()) {
+        next = std::move(spare_.back());
+        spare_.pop_back();
+    }
+    next.assign(pending_.begin() + static_cast<std::ptrdiff_t>(cut), pending_.end());
+
+    Batch batch;
+    batch.storage = std::move(pending_);
+    batch.data = std::string_view(batch.storage.data(), cut);
+    batch.inputBytes = cut;
+    batch.offset = offset_;
+    offset_ += cut;
+    pending_ = std::move(next);
+
+    Batch released;
+    bool fed = feedBatch(std::move(batch), released, error);
+    if (released.storage.capacity() != 0) spare_.push_back(std::move(released.storage));
+    return fed;
+}
+
+void WordCounter::settle() {
+    merges_.wait();
+    if (merging_.storage.capacity() != 0) spare_.push_back(std::move(merging_.storage));
+    merging_ = Batch{};
+}
+
+bool WordCounter::spillIfFull(std::string& error) {
+    // with a memory limit, a global table that outgrows it is written out
+    // as a sorted run and emptied; the runs are merged back at the end.
+    // the estimate includes the entry list the spill sort needs
+    if (options_.memoryLimit == 0) return true;
+    std::size_t need = global_.bytesInUse() + global_.size() * sizeof(CountEntry);
+    if (need <= options_.memoryLimit) return true;
+    logAt(LogLevel::Info) << "[Spill] run " << spills_.runCount() + 1
+                          << ": " << global_.size() << " words\n";
+    auto spillStart = MetricsClock::now();
+    bool spilled = spills_.spill(pool_, global_, error);
+    metrics_.at(Stage::Spill) += since(spillStart);
+    return spilled;
+}
+
+bool WordCounter::addResults(const ResultFile& file, std::string& error) {
+    if (finished_) {
+        error = "the counter has already finished";
+        return false;
+    }
+    if (options_.ngram > 1 || options_.approx.enabled) {
+        error = options_.ngram > 1 ? "result files can't be added to an n-gram count"
+                                   : "result files can't be added to an approximate count";
+        return false;
+    }
+    // the shards may not be merged into by two groups at once
+    settle();
+    global_.mergeResultFile(pool_, file);
+    return spillIfFull(error);
+}
+
+bool WordCounter::collect(std::vector<CountEntry>& out, std::string& error) {
+    out.clear();
+    if (spills_.runCount() > 0) {
+        // what is left in memory becomes the last run; merging the sorted
+        // runs yields the A → Z order directly
+        auto spillStart = MetricsClock::now();
+        bool merged = (global_.size() == 0 || spills_.spill(pool_, global_, error))
+                      && spills_.merge(pool_, out, error);
+        metrics_.at(Stage::Spill) += since(spillStart);
+        return merged;
+    }
+    auto sortStart = MetricsClock::now();
+    out.reserve(global_.size());
+    global_.forEach([&](std::string_view word, std::size_t count, std::uint64_t hash) {
+        out.push_back({word, hash, count});
+    });
+    parallelRadixSort(pool_, out, [](CountEntry const& e) { return e.key; });
+    metrics_.at(Stage::SortAlpha) += since(sortStart);
+    return true;
+}
+
+bool WordCounter::snapshot(WordCounts& out, std::string& error) {
+    std::vector<CountEntry> entries;
+    if (spilled_) {
+        copySpilled(out);
+        return true;
+    }
+    if (finished_) {
+        entries = results_.entries_;
+    } else {
+        if (!countPending(false, error)) return false;
+        settle();
+        if (options_.approx.enabled) {
+            CountMinSketch sketch;
+            SpaceSaving heavy;
+            mergeSummaries(sketch, heavy);
+            heavyHitterCounts(sketch, heavy, out.entries_, out.words_);
+            return true;
+        }
+        if (!collect(entries, error)) return false;
+    }
+    if (!finished_ && options_.ngram > 1) {
+        spellOut(entries, out.words_);
+        out.entries_ = std::move(entries);
+        return true;
+    }
+    // entries view the global table or the mapped runs, which later
+    // batches change; copy the words out
+    std::size_t bytes = 0;
+    for (auto const& e : entries) bytes += e.key.size();
+    out.words_.clear();
+    out.words_.reserve(bytes);
+    for (auto const& e : entries) out.words_.append(e.key);
+    std::size_t at = 0;
+    for (auto& e : entries) {
+        std::size_t size = e.key.size();
+        e.key = std::string_view(out.words_.data() + at, size);
+        at += size;
+    }
+    out.entries_ = std::move(entries);
+    return true;
+}
+
+void WordCounter::copySpilled(WordCounts& out) {
+    // every range is copied straight into its place, found from the sizes
+    std::size_t ranges = spilled_->rangeCount();
+    std::vector<std::size_t> firstWord(ranges + 1, 0), firstByte(ranges + 1, 0);
+    for (std::size_t r = 0; r < ranges; ++r) {
+        firstWord[r + 1] = firstWord[r] + spilled_->range(r).words;
+        firstByte[r + 1] = firstByte[r] + spilled_->range(r).keyBytes;
+    }
+    out.entries_.assign(firstWord[ranges], CountEntry{});
+    out.words_.assign(firstByte[ranges], '\0');
+    TaskGroup tasks(pool_);
+    for (std::size_t r = 0; r < ranges; ++r)
+        tasks.run([&, r] {
+            CountEntry* entry = out.entries_.data() + firstWord[r];
+            char* bytes = out.words_.data() + firstByte[r];
+            spilled_->forEach(r, [&](std::string_view word, std::uint64_t count) {
+                std::memcpy(bytes, word.data(), word.size());
+                std::string_view key(bytes, word.size());
+                *entry++ = {key, CountTable::hashOf(key), count};
+                bytes += word.size();
+            });
+        });
+    tasks.wait();
+}
+
+void WordCounter::mostFrequent(std::size_t k, WordCounts& out) {
+    out.entries_.clear();
+    out.words_.clear();
+    if (!spilled_ || k == 0) return;
+    struct Candidate {
+        std::uint64_t count;
+        std::uint64_t position;  // in the A -> Z list
+        std::string word;
+    };
+    // more frequent first, equal counts A -> Z
+    auto better = [](std::uint64_t count, std::uint64_t position, Candidate const& than) {
+        return count != than.count ? count > than.count : position < than.position;
+    };
+    auto before = [&](Candidate const& a, Candidate const& b) {
+        return better(a.count, a.position, b);
+    };
+
+    // every range keeps its own best k in a heap whose top is the worst
+    // of them; a word is copied only when it gets in
+    std::size_t ranges = spilled_->rangeCount();
+    std::vector<std::vector<Candidate>> best(ranges);
+    {
+        TaskGroup tasks(pool_);
+        std::uint64_t first = 0;
+        for (std::size_t r = 0; r < ranges; ++r) {
+            tasks.run([&, r, first] {
+                auto& heap = best[r];
+                std::uint64_t position = first;
+                spilled_->forEach(r, [&](std::string_view word, std::uint64_t count) {
+                    if (heap.size() < k) {
+                        heap.push_back({count, position, std::string(word)});
+                        std::push_heap(heap.begin(), heap.end(), before);
+                    } else if (better(count, position, heap.front())) {
+                        std::pop_heap(heap.begin(), heap.end(), before);
+                        heap.back() = {count, position, std::string(word)};
+                        std::push_heap(heap.begin(), heap.end(), before);
+                    }
+                    ++position;
+                });
+            });
+            first += spilled_->range(r).words;
+        }
+        tasks.wait();
+    }
+
+    std::vector<Candidate> top;
+    for (auto& heap : best)
+        for (auto& c : heap) top.push_back(std::move(c));
+    if (top.size() > k) {
+        std::nth_element(top.begin(), top.begin() + static_cast<std::ptrdiff_t>(k), top.end(),
+                         before);
+        top.resize(k);
+    }
+    std::sort(top.begin(), top.end(),
+              [](Candidate const& a, Candidate const& b) { return a.position < b.position; });
+
+    std::size_t bytes = 0;
+    for (auto const& c : top) bytes += c.word.size();
+    out.words_.reserve(bytes);
+    for (auto const& c : top) {
+        std::size_t at = out.words_.size();
+        out.words_.append(c.word);
+        std::string_view key(out.words_.data() + at, c.word.size());
+        out.entries_.push_back({key, CountTable::hashOf(key), c.count});
+    }
+}
+
+const RangedCounts& WordCounter::spilledResults() const { return *spilled_; }
+
+void WordCounter::spellOut(std::vector<CountEntry>& entries, std::string& words) const {
+    // IDs are A -> Z positions and a space sorts before every word byte,
+    // so the A -> Z order of the keys is that of the spelled-out n-grams
+    const WordCounts& dictionary = *options_.dictionary;
+    std::size_t bytes = 0;
+    for (auto const& e : entries)
+        for (std::size_t i = 0; i < e.key.size(); i += kIdBytes)
+            bytes += dictionary[idAt(e.key.data() + i)].key.size() + 1;
+    words.clear();
+    words.reserve(bytes);
+    for (auto& e : entries) {
+        std::size_t at = words.size();
+        for (std::size_t i = 0; i < e.key.size(); i += kIdBytes) {
+            if (i != 0) words.push_back(' ');
+            words.append(dictionary[idAt(e.key.data() + i)].key);
+        }
+        // `words` never reallocates, so earlier views stay valid
+        e.key = std::string_view(words.data() + at, words.size() - at);
+        e.hash = CountTable::hashOf(e.key);
+    }
+}
+
+bool WordCounter::finish(std::string& error) {
+    if (finished_) return true;
+    auto countStart = MetricsClock::now();
+    if (!countPending(true, error)) return false;
+    settle();
+    metrics_.at(Stage::Count) += since(countStart);
+    if (options_.approx.enabled) {
+        auto sortStart = MetricsClock::now();
+        SpaceSaving heavy;
+        mergeSummaries(sketch_, heavy);
+        heavyHitterCounts(sketch_, heavy, results_.entries_, results_.words_);
+        metrics_.at(Stage::SortAlpha) += since(sortStart);
+        finished_ = true;
+        metrics_.words = wordsCounted();
+        metrics_.uniqueWords = results_.size();
+        return true;
+    }
+    if (spills_.runCount() > 0) {
+        // what is left in memory becomes the last run, and the results
+        // stay in the runs, to be merged as they are read
+        auto spillStart = MetricsClock::now();
+        if ((global_.size() != 0 && !spills_.spill(pool_, global_, error))
+            || !spills_.openMerged(pool_, error))
+            return false;
+        spilled_ = std::make_unique<SpilledResults>(
+            spills_, options_.ngram > 1 ? options_.dictionary : nullptr);
+        spilled_->measure(pool_);
+        metrics_.at(Stage::Spill) += since(spillStart);
+        finished_ = true;
+        metrics_.words = wordsCounted();
+        metrics_.uniqueWords = spilled_->words();
+        return true;
+    }
+    // entries view the words in global_'s shards, which live as long as
+    // the counter
+    if (!collect(results_.entries_, error)) return false;
+    if (options_.ngram > 1) spellOut(results_.entries_, results_.words_);
+    finished_ = true;
+    metrics_.words = wordsCounted();
+    metrics_.uniqueWords = results_.size();
+    return true;
+}
+
+std::vector<std::size_t> WordCounter::rankByFrequency(const WordCounts& counts, std::size_t topK) {
+    // rank positions by count (high→low) instead of copying and re-sorting
+    // the words; equal counts keep their A → Z order
+    auto countAt = [&](std::size_t i) { return counts[i].count; };
+    return topK != 0 ? topByFrequency(pool_, counts.size(), topK, countAt)
+                     : ::rankByFrequency(pool_, counts.size(), countAt);
+}
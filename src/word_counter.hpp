@@ -0,0 +1,256 @@
+// src/word_counter.hpp
+//
+// The counting engine as a library (libwordcount). A WordCounter owns a
+// thread pool, the per-thread tables and the sharded global table, and
+// runs the same pipeline as the wordcount tool: every batch of text is
+// mapped in stealable chunks, bucketed by shard and merged while the next
+// batch is being mapped. Text can be fed in pieces of any size, e.g. one
+// document at a time as it arrives; nothing is written to disk unless a
+// memory limit makes the table spill.
+//
+//     WordCounter counter(options);
+//     std::string error;
+//     for (auto const& doc : documents)
+//         if (!counter.feed(doc, error)) ...
+//     if (!counter.finish(error)) ...
+//     for (auto const& e : counter.results())
+//         use(e.key, e.count);
+//
+// A WordCounter is used from one thread at a time; the thread that creates
+// it also joins its pool (and is pinned if options.pinning asks for it,
+// until the counter is destroyed on that thread, which gets its CPUs
+// back), so creating and feeding it on the same thread is best. The word hash
+// seed and the tokenizer kernel are process-wide settings
+// (setWordHashSeed, selectTokenizerKernel) made before the first counter
+// is created. Progress messages go through log.hpp; a service would turn
+// them down with setLogLevel(LogLevel::Error).
+//
+// With options.approx.enabled the counter keeps no word table at all:
+// each thread folds its counts into a Count-Min sketch and a Space-Saving
+// list (approx_counts.hpp), and results() are the heavy hitters with their
+// estimated counts, in memory that doesn't grow with the vocabulary.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "approx_counts.hpp"
+#include "batch_reader.hpp"
+#include "count_table.hpp"
+#include "hot_word_cache.hpp"
+#include "metrics.hpp"
+#include "numa.hpp"
+#include "ranged_counts.hpp"
+#include "result_file.hpp"
+#include "sharded_counts.hpp"
+#include "spill.hpp"
+#include "thread_pool.hpp"
+#include "tokenizer.hpp"
+
+struct WordCounterOptions {
+    TokenizerOptions tokenizer;
+    unsigned int threads = 0;     // 0 = one per hardware thread
+    ThreadPinning pinning = ThreadPinning::None;
+    std::size_t batchBytes = 0;   // bytes counted per batch; 0 = 256M
+    std::size_t expectedWords = 4'000'000;  // distinct words to reserve room for
+    std::size_t memoryLimit = 0;  // bytes for the global table, 0 = no limit
+    std::string spillDir;         // where runs go past the limit; "" = $TMPDIR or /tmp
+    bool hotWordCache = true;     // hot-word cache in front of the thread tables
+    bool detailedTiming = false;  // time tokenizing and counting apart in metrics()
+
+    // Counts runs of `ngram` adjacent words instead of single words. A
+    // word is kept as its index in `dictionary`, the A -> Z word counts of
+    // the same text (a first pass with ngram 1), so an n-gram key is
+    // 4 * ngram bytes however long its words are; results() spells the
+    // keys out as the words joined by spaces. The dictionary must outlive
+    // the counter.
+    unsigned int ngram = 1;
+    const class WordCounts* dictionary = nullptr;
+
+    // Approximate counts of the most frequent words instead of exact
+    // counts of all of them (approx_counts.hpp); not with n-grams, result
+    // files or a memory limit, which has nothing to bound then.
+    ApproxOptions approx;
+};
+
+// Words with their counts, A -> Z. Either views of storage a WordCounter
+// keeps (results()) or an owned copy (snapshot()).
+class WordCounts {
+public:
+    using const_iterator = std::vector<CountEntry>::const_iterator;
+
+    std::size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    const CountEntry& operator[](std::size_t i) const { return entries_[i]; }
+    const_iterator begin() const { return entries_.begin(); }
+    const_iterator end() const { return entries_.end(); }
+    const std::vector<CountEntry>& entries() const { return entries_; }
+
+    // the count of `word`, 0 if it never occurred (binary search)
+    std::uint64_t count(std::string_view word) const;
+
+private:
+    friend class WordCounter;
+
+    std::vector<CountEntry> entries_;
+    std::string words_;  // the bytes entries_ view, for an owned copy
+};
+
+class WordCounter {
+public:
+    explicit WordCounter(const WordCounterOptions& options = {});
+    ~WordCounter();
+
+    WordCounter(const WordCounter&) = delete;
+    WordCounter& operator=(const WordCounter&) = delete;
+
+    // Counts `text` as the continuation of everything fed so far: a word
+    // cut off at the end of one call is joined with the start of the next
+    // (end a document with a separator, e.g. '\n', to keep its last word
+    // apart). The bytes are copied, so the caller may reuse them at once.
+    // On failure (a spill couldn't be written) returns false with a
+    // message in `error`.
+    bool feed(std::string_view text, std::string& error);
+    bool feed(const char* data, std::size_t size, std::string& error) {
+        return feed(std::string_view(data, size), error);
+    }
+
+    // Counts a word-aligned batch in place, without a copy: the batch is
+    // kept until it has been merged, and the batch before it, which is
+    // merged by then, is handed back in `released` for reuse (the
+    // BatchReader path of the wordcount tool).
+    bool feedBatch(Batch&& batch, Batch& released, std::string& error);
+
+    // adds every word of a result file (e.g. an earlier run's checkpoint);
+    // not for an n-gram or approximate count
+    bool addResults(const ResultFile& file, std::string& error);
+
+    // The counts of everything fed so far, as an owned copy, while feeding
+    // goes on. A word still cut off at the end of the last feed() is only
+    // counted once it is complete. With spilled runs, the table is spilled
+    // once more to build the copy.
+    bool snapshot(WordCounts& out, std::string& error);
+
+    // Counts what is still buffered and sorts the final counts into
+    // results(), or, if the table spilled, leaves them in the runs to be
+    // read from spilledResults(). Nothing can be fed afterwards.
+    bool finish(std::string& error);
+    bool finished() const { return finished_; }
+
+    // the final counts, A -> Z; valid after finish(), as long as the
+    // counter lives; empty if spilled(). For an approximate count, the
+    // heavy hitters with their estimates.
+    const WordCounts& results() const { return results_; }
+
+    // After finish(), true if the table spilled under the memory limit.
+    // The A -> Z list is then never held in memory whole: it is read from
+    // spilledResults() range by range, merged from the runs as it goes
+    // (output_writer.hpp and result_file.hpp write it that way), and
+    // mostFrequent() picks the top of it. snapshot() still copies it all.
+    bool spilled() const { return spilled_ != nullptr; }
+    const RangedCounts& spilledResults() const;
+
+    // After a spilled finish(): the `k` most frequent words (equal counts
+    // A -> Z, as in rankByFrequency) as an owned copy, A -> Z.
+    void mostFrequent(std::size_t k, WordCounts& out);
+    WordCounts::const_iterator begin() const { return results_.begin(); }
+    WordCounts::const_iterator end() const { return results_.end(); }
+
+    // Positions in `counts` by descending count, equal counts A -> Z; only
+    // the first `topK` if it isn't 0. Ranked on the counter's pool.
+    std::vector<std::size_t> rankByFrequency(const WordCounts& counts, std::size_t topK = 0);
+
+    // Approximate counts, after finish(): the estimate of any word (as
+    // tokenized, e.g. folded), which is at least its true count, and the
+    // most it exceeds that by with probability 1 - approx.delta
+    std::uint64_t estimate(std::string_view word) const;
+    std::uint64_t errorBound() const { return sketch_.errorBound(); }
+
+    ThreadPool& pool() { return pool_; }
+    unsigned int threads() const { return threads_; }
+    // input bytes, words, spill and sort times so far; the caller adds
+    // its own stages
+    RunMetrics& metrics() { return metrics_; }
+    std::uint64_t wordsCounted() const { return words_.load(std::memory_order_relaxed); }
+
+private:
+    void mapBatch(const Batch& batch);
+    bool spillIfFull(std::string& error);
+    // counts pending_ up to its last word boundary, everything if `final`
+    bool countPending(bool final, std::string& error);
+    // waits for the last batch's merge and recycles its buffer
+    void settle();
+    // words of the global table (or the spilled runs) A -> Z into `out`,
+    // as views
+    bool collect(std::vector<CountEntry>& out, std::string& error);
+    // the spilled list, copied out into `out`
+    void copySpilled(WordCounts& out);
+    // n-gram counts: the ID keys of `entries` become their words, stored in
+    // `words`
+    void spellOut(std::vector<CountEntry>& entries, std::string& words) const;
+    // false with a message if the options can't be counted with
+    bool usable(std::string& error) const;
+    // approximate counts: folds thread slot t's table into its summaries
+    void summarize(const CountTable& table, unsigned int t);
+    // the summaries of all slots, merged; the sketches in slices on the pool
+    void mergeSummaries(CountMinSketch& sketch, SpaceSaving& heavy);
+    // the words of `heavy` A -> Z with their estimates, the words stored
+    // in `words`
+    void heavyHitterCounts(const CountMinSketch& sketch, const SpaceSaving& heavy,
+                           std::vector<CountEntry>& entries, std::string& words);
+
+    WordCounterOptions options_;
+    unsigned int threads_;
+    std::size_t batchBytes_;
+    std::size_t localExpected_;
+    ThreadPlacement placement_;
+    ThreadPool pool_;
+    RunMetrics metrics_;
+    std::atomic<std::uint64_t> words_{0};
+
+    // one table (and hot-word cache and shard buckets) per pool slot, plus
+    // one for a feeding thread outside the pool; two sets, so one batch
+    // can be mapped while the previous one is merged
+    std::vector<CountTable> tables_[2];
+    std::vector<HotWordCache> hotWords_[2];
+    std::vector<ShardedEntries> shards_[2];
+    unsigned int current_ = 0;
+    ShardedCounts global_;
+    SpillRuns spills_;
+    // after a spilled finish(): the merged runs, read range by range
+    class SpilledResults;
+    std::unique_ptr<SpilledResults> spilled_;
+
+    // the map function of the tokenizer options' TokenPolicy, picked once
+    CountTable stopwords_;
+    WordFilter filter_;
+    unsigned int mapPolicy_ = 0;
+    // n-grams: word -> ID + 1, and the last IDs of the batch before
+    CountTable dictionary_;
+    std::string tail_;
+    // approximate counts: summaries per pool slot (as tables_, one for a
+    // feeding thread outside the pool), and after finish() the merged sketch
+    std::vector<CountMinSketch> sketches_;
+    std::vector<SpaceSaving> heavyHitters_;
+    CountMinSketch sketch_;
+
+    // feed(): text not yet counted, and buffers to reuse
+    std::vector<char> pending_;
+    std::size_t pendingLimit_;  // size at which pending_ is counted
+    std::vector<std::vector<char>> spare_;
+    std::size_t offset_ = 0;  // input bytes handed to the map phase so far
+
+    WordCounts results_;
+    bool finished_ = false;
+
+    // last: the merge of the previous batch still running on the pool uses
+    // everything above, so it is waited for before any of it goes away
+    Batch merging_;
+    TaskGroup merges_;
+};
@@ -0,0 +1,134 @@
+// src/word_dictionary.hpp
+//
+// Dictionary-encoded word counts: the table behind every shard of the
+// global counts. Each distinct word is interned under a dense 32-bit ID,
+// the order in which it was first added, and its entry (hash, count and a
+// view of its bytes in the dictionary's Arena) is element ID of one array.
+// The hash index in front of it holds only (tag, ID) pairs of 8 bytes.
+//
+// Compared with a CountTable, whose 32-byte slots are the entries, the
+// reserve kept free for growth costs a quarter as much, and reading every
+// word is a walk over exactly size() entries instead of a scan of all
+// slots, which matters once a table is sized for millions of words. An
+// insert costs one more cache miss (the entry, after its slot), which the
+// reduce pays once per distinct word of a batch.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "arena.hpp"
+
+class WordDictionary {
+public:
+    explicit WordDictionary(std::size_t expected = 0) { reserve(expected); }
+
+    // adds `count` to `key`, interning a copy of it under the next ID if
+    // it is new
+    void add(std::string_view key, std::uint64_t hash, std::uint64_t count) {
+        if ((entries_.size() + 1) * 10 > slots_.size() * 7)  // keep load <= 0.7
+            grow();
+        const std::uint32_t tag = static_cast<std::uint32_t>(hash >> 32);
+        std::size_t mask = slots_.size() - 1;
+        for (std::size_t i = slotFor(hash);; i = (i + 1) & mask) {
+            Slot& s = slots_[i];
+            if (s.id == 0) {
+                std::string_view stored = keys_.store(key);
+                entries_.push_back({hash, count, stored.data(),
+                                    static_cast<std::uint32_t>(stored.size())});
+                s = {tag, static_cast<std::uint32_t>(entries_.size())};
+                return;
+            }
+            if (s.tag != tag) continue;
+            Entry& e = entries_[s.id - 1];
+            if (e.hash == hash && e.keyLength == key.size()
+                && std::memcmp(e.key, key.data(), key.size()) == 0) {
+                e.count += count;
+                return;
+            }
+        }
+    }
+
+    std::size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+
+    std::string_view word(std::uint32_t id) const {
+        return {entries_[id].key, entries_[id].keyLength};
+    }
+    std::uint64_t count(std::uint32_t id) const { return entries_[id].count; }
+    std::uint64_t hash(std::uint32_t id) const { return entries_[id].hash; }
+
+    // Memory the current words need: their slots at the load limit, their
+    // entries and their copied bytes. Capacity kept by clear() is not
+    // counted, since it is reused before anything new is allocated.
+    std::size_t bytesInUse() const {
+        return entries_.size() * (sizeof(Slot) * 10 / 7 + sizeof(Entry)) + keys_.used();
+    }
+
+    // makes room for `expected` words without growing the index; the
+    // entry array only reserves address space, its pages are touched as
+    // words arrive
+    void reserve(std::size_t expected) {
+        std::size_t want = 16;
+        while (want * 7 < expected * 10) want <<= 1;
+        if (want > slots_.size()) rehash(want);
+        entries_.reserve(expected);
+    }
+
+    // drops all words but keeps the allocated capacity
+    void clear() {
+        if (entries_.empty()) return;
+        std::fill(slots_.begin(), slots_.end(), Slot{});
+        entries_.clear();
+        keys_.reset();
+    }
+
+    // calls f(key, count, hash) for every word, in ID order
+    template<typename F>
+    void forEach(F&& f) const {
+        for (auto const& e : entries_) f(std::string_view(e.key, e.keyLength), e.count, e.hash);
+    }
+
+private:
+    struct Slot {
+        std::uint32_t tag = 0;  // high half of the hash
+        std::uint32_t id = 0;   // ID + 1; 0 marks an empty slot
+    };
+    struct Entry {
+        std::uint64_t hash;
+        std::uint64_t count;
+        const char* key;  // into keys_
+        std::uint32_t keyLength;
+    };
+
+    // Fibonacci hashing, as in CountTable
+    std::size_t slotFor(std::uint64_t hash) const {
+        return static_cast<std::size_t>((hash * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+
+    void grow() { rehash(slots_.empty() ? 16 : slots_.size() * 2); }
+
+    // the entries keep their IDs; only the index is rebuilt
+    void rehash(std::size_t capacity) {
+        slots_.assign(capacity, Slot{});
+        shift_ = 64;
+        for (std::size_t c = capacity; c > 1; c >>= 1) --shift_;
+        std::size_t mask = capacity - 1;
+        for (std::size_t id = 0; id < entries_.size(); ++id) {
+            std::uint64_t hash = entries_[id].hash;
+            std::size_t i = slotFor(hash);
+            while (slots_[i].id != 0) i = (i + 1) & mask;
+            slots_[i] = {static_cast<std::uint32_t>(hash >> 32), static_cast<std::uint32_t>(id + 1)};
+        }
+    }
+
+    std::vector<Slot> slots_;
+    std::vector<Entry> entries_;
+    Arena keys_;
+    unsigned shift_ = 64;
+};
@@ -0,0 +1,14 @@
+// src/word_hash.cpp
+
+#include "word_hash.hpp"
+
+namespace word_hash_detail {
+
+std::uint64_t mixedSeed = mix(kSecret[0], kSecret[1]);  // seed 0
+
+}  // namespace word_hash_detail
+
+void setWordHashSeed(std::uint64_t seed) {
+    using namespace word_hash_detail;
+    mixedSeed = seed ^ mix(seed ^ kSecret[0], kSecret[1]);
+}
@@ -0,0 +1,105 @@
+// src/word_hash.hpp
+//
+// The one hash every table uses for a word. A word is hashed once, when it
+// first reaches a map thread's table; the hash is stored in the slot and
+// carried with the entry from then on, so the shard choice, the global
+// insert and the duplicate check of the reduce all reuse it.
+//
+// The function is wyhash (final version 4, public domain, by Wang Yi),
+// which reads a word of up to 16 bytes in at most four overlapping loads
+// and mixes it with two 64x64->128-bit multiplies, without a loop. That is
+// markedly cheaper for short words than std::hash (64-bit MurmurHash2 in
+// libstdc++), and its output bits are uniform, which the shard choice (low
+// bits) and the table probe (high bits) both rely on.
+//
+// The seed is fixed by default, so runs are reproducible. A different seed
+// (--hash-seed) changes every hash, so input crafted to collide in one
+// table layout cannot target a run whose seed it doesn't know.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace word_hash_detail {
+
+constexpr std::uint64_t kSecret[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull,
+};
+
+inline void multiply(std::uint64_t& a, std::uint64_t& b) {
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    a = static_cast<std::uint64_t>(r);
+    b = static_cast<std::uint64_t>(r >> 64);
+}
+
+inline std::uint64_t mix(std::uint64_t a, std::uint64_t b) {
+    multiply(a, b);
+    return a ^ b;
+}
+
+inline std::uint64_t read8(const unsigned char* p) {
+    std::uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+inline std::uint64_t read4(const unsigned char* p) {
+    std::uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+// the seed after wyhash's per-seed mixing, so a hash doesn't redo it
+extern std::uint64_t mixedSeed;
+
+}  // namespace word_hash_detail
+
+// Sets the seed of every later hashOf(). Call before any table is filled,
+// since hashes from different seeds don't match.
+void setWordHashSeed(std::uint64_t seed);
+
+inline std::uint64_t wordHash(std::string_view word) {
+    using namespace word_hash_detail;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(word.data());
+    std::size_t len = word.size();
+    std::uint64_t seed = mixedSeed;
+    std::uint64_t a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+            b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = (std::uint64_t(p[0]) << 16) | (std::uint64_t(p[len >> 1]) << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        std::size_t i = len;
+        if (i > 48) {
+            std::uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = mix(read8(p) ^ kSecret[1], read8(p + 8) ^ seed);
+                see1 = mix(read8(p + 16) ^ kSecret[2], read8(p + 24) ^ see1);
+                see2 = mix(read8(p + 32) ^ kSecret[3], read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = mix(read8(p) ^ kSecret[1], read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = read8(p + i - 16);
+        b = read8(p + i - 8);
+    }
+    a ^= kSecret[1];
+    b ^= seed;
+    multiply(a, b);
+    return mix(a ^ kSecret[0] ^ len, b ^ kSecret[1]);
+}
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Generates src/unicode_tables.cpp from Python's unicodedata.
+
+    python3 tools/gen_unicode_tables.py > src/unicode_tables.cpp
+
+Word characters are the Unicode letters (L*) and marks (M*), so decomposed
+letters such as "a" + U+0308 stay one word. The case-fold table covers
+U+0000..U+017F (ASCII, Latin-1 and Latin Extended-A) and only contains
+mappings whose lowercase is a single code point of the same UTF-8 length,
+so folding never changes the length of a word.
+"""
+import unicodedata
+
+MAX_CP = 0x110000
+BLOCK = 256
+FOLD_LIMIT = 0x180
+
+
+def is_word_char(cp):
+    return unicodedata.category(chr(cp))[0] in "LM"
+
+
+def utf8_len(cp):
+    return 1 if cp < 0x80 else 2 if cp < 0x800 else 3 if cp < 0x10000 else 4
+
+
+blocks = []
+index = {}
+stage1 = []
+for base in range(0, MAX_CP, BLOCK):
+    words = [0] * (BLOCK // 32)
+    for cp in range(base, base + BLOCK):
+        if is_word_char(cp):
+            words[(cp - base) // 32] |= 1 << ((cp - base) % 32)
+    key = tuple(words)
+    if key not in index:
+        index[key] = len(blocks)
+        blocks.append(key)
+    stage1.append(index[key])
+assert len(blocks) <= 256
+
+fold = []
+for cp in range(FOLD_LIMIT):
+    low = chr(cp).lower()
+    if len(low) == 1 and utf8_len(ord(low)) == utf8_len(cp):
+        fold.append(ord(low))
+    else:
+        fold.append(cp)
+
+out = []
+out.append("// src/unicode_tables.cpp")
+out.append("//")
+out.append("// Generated by tools/gen_unicode_tables.py from Unicode %s; do not edit."
+           % unicodedata.unidata_version)
+out.append("")
+out.append('#include "unicode_tables.hpp"')
+out.append("")
+out.append("const std::uint8_t kWordCharPage[%d] = {" % len(stage1))
+for i in range(0, len(stage1), 24):
+    out.append("    " + ", ".join(str(v) for v in stage1[i:i + 24]) + ",")
+out.append("};")
+out.append("")
+out.append("const std::uint32_t kWordCharBits[%d][%d] = {" % (len(blocks), BLOCK // 32))
+for b in blocks:
+    out.append("    {" + ", ".join("0x%08x" % w for w in b) + "},")
+out.append("};")
+out.append("")
+out.append("const std::uint16_t kLatinLower[%d] = {" % FOLD_LIMIT)
+for i in range(0, FOLD_LIMIT, 12):
+    out.append("    " + ", ".join("0x%04x" % v for v in fold[i:i + 12]) + ",")
+out.append("};")
+print("\n".join(out))